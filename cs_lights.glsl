@@ -0,0 +1,165 @@
+//  point and spot lights of the deferred lighting, evaluated per pixel
+//  into the local light target that the lighting pass adds.
+//
+//  with TILED_LIGHTS every workgroup first culls all lights against its
+//  TILE_SIZE x TILE_SIZE tile: the side planes of the tile's frustum and
+//  the view depth range of the g-buffer within it. its pixels then only
+//  loop over the lights that passed; a tile where more than
+//  MAX_TILE_LIGHTS pass evaluates all lights instead, and is counted.
+//  without, every pixel evaluates every light, as the reference the
+//  culling is measured against.
+
+#define TILE_SIZE 16
+#ifndef MAX_TILE_LIGHTS
+#define MAX_TILE_LIGHTS 512
+#endif
+#define GROUP_THREADS (TILE_SIZE * TILE_SIZE)
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+
+uniform sampler2D g_normal;
+uniform sampler2D depth_buffer;     // 1 where nothing was drawn
+
+layout(rgba16f, binding = 0) uniform writeonly image2D light_image;
+
+//  in world space, see SSAORenderer::LocalLight
+struct Light
+{
+    vec4 position;      // w = radius of influence
+    vec4 color;         // w = cosine of the inner spot angle
+    vec4 direction;     // normalized; w = cosine of the outer spot angle, -1 for point lights
+};
+
+layout(std430, binding = 0) readonly buffer Lights
+{
+    Light lights[];
+};
+uniform int light_count;
+
+#ifdef TILED_LIGHTS
+//  view depth range of the tile, as the bits of positive floats (which
+//  order like the floats), and the lights that touch it
+shared uint s_min_z, s_max_z;
+shared uint s_light_count;
+shared uint s_lights[MAX_TILE_LIGHTS];
+
+//  tiles whose lights did not fit into s_lights
+layout(std430, binding = 1) buffer TileStatistics
+{
+    uint overflow_tiles;
+};
+
+//  view ray through a point of normalized device coordinates
+vec3 view_ray(vec2 ndc)
+{
+    vec4 ray = inverse_projection_matrix * vec4(ndc, 1.0, 1.0);
+    return ray.xyz / ray.w;
+}
+#endif
+
+//  Blinn-Phong of one light, unshadowed, with an inverse square falloff
+//  that is windowed to reach zero at the radius
+vec3 local_light(Light light, vec3 P, vec3 N, vec3 V)
+{
+    vec3 L = (view_matrix * vec4(light.position.xyz, 1.0)).xyz - P;
+    float d = length(L);
+    L /= d;
+    float window = clamp(1.0 - pow(d / light.position.w, 4.0), 0.0, 1.0);
+    float attenuation = window * window / (d * d + 0.01);
+    if (light.direction.w > -1.0)
+    {
+        vec3 axis = mat3(view_matrix) * light.direction.xyz;
+        attenuation *= smoothstep(light.direction.w, light.color.w, dot(-L, axis));
+    }
+    vec3 H = normalize(L + V);
+    float diffuse = kd * max(dot(L, N), 0.0);
+    float specular = ks * pow(max(dot(H, N), 0.0), shininess);
+    return light.color.rgb * (attenuation * (diffuse + specular));
+}
+
+void main()
+{
+    ivec2 size = imageSize(light_image);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+    bool inside = all(lessThan(texel, size));
+    bool background = !inside || texelFetch(depth_buffer, texel, 0).r == 1.0;
+    vec3 P = gbuffer_position(uv);
+
+#ifdef TILED_LIGHTS
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        s_min_z = floatBitsToUint(3.402823e38);
+        s_max_z = 0u;
+        s_light_count = 0u;
+    }
+    barrier();
+    if (!background)
+    {
+        atomicMin(s_min_z, floatBitsToUint(-P.z));
+        atomicMax(s_max_z, floatBitsToUint(-P.z));
+    }
+    barrier();
+    float min_z = uintBitsToFloat(s_min_z);
+    float max_z = uintBitsToFloat(s_max_z);
+
+    //  side planes of the tile through the eye, from the view rays
+    //  through its corners (counter-clockwise), normals pointing inwards
+    vec2 tile_min = vec2(gl_WorkGroupID.xy * uint(TILE_SIZE)) / vec2(size) * 2.0 - 1.0;
+    vec2 tile_max = vec2((gl_WorkGroupID.xy + 1u) * uint(TILE_SIZE)) / vec2(size) * 2.0 - 1.0;
+    vec3 corners[4] = vec3[4](
+        view_ray(tile_min), view_ray(vec2(tile_max.x, tile_min.y)),
+        view_ray(tile_max), view_ray(vec2(tile_min.x, tile_max.y)));
+    vec3 planes[4];
+    for (int i = 0; i < 4; i++)
+        planes[i] = normalize(cross(corners[(i + 1) % 4], corners[i]));
+
+    //  every thread tests every GROUP_THREADS-th light. an empty tile has
+    //  min_z > max_z, so that no light passes.
+    for (uint i = gl_LocalInvocationIndex; i < uint(light_count); i += uint(GROUP_THREADS))
+    {
+        vec3 center = (view_matrix * vec4(lights[i].position.xyz, 1.0)).xyz;
+        float radius = lights[i].position.w;
+        bool visible = -center.z + radius >= min_z && -center.z - radius <= max_z;
+        for (int p = 0; p < 4; p++)
+            visible = visible && dot(planes[p], center) >= -radius;
+        if (visible)
+        {
+            uint slot = atomicAdd(s_light_count, 1u);
+            if (slot < uint(MAX_TILE_LIGHTS))
+                s_lights[slot] = i;
+        }
+    }
+    barrier();
+
+    //  too many lights for the list: they are all evaluated, unculled
+    bool overflow = s_light_count > uint(MAX_TILE_LIGHTS);
+    if (overflow && gl_LocalInvocationIndex == 0u)
+        atomicAdd(overflow_tiles, 1u);
+    uint count = overflow ? uint(light_count) : s_light_count;
+#else
+    uint count = uint(light_count);
+#endif
+
+    if (!inside)
+        return;
+    vec3 color = vec3(0.0);
+    if (!background)
+    {
+        vec3 N = gbuffer_normal(g_normal, uv);
+        vec3 V = normalize(-P);
+        for (uint i = 0u; i < count; i++)
+        {
+#ifdef TILED_LIGHTS
+            color += local_light(lights[overflow ? i : s_lights[i]], P, N, V);
+#else
+            color += local_light(lights[i], P, N, V);
+#endif
+        }
+    }
+    imageStore(light_image, texel, vec4(color, 1.0));
+}
@@ -0,0 +1,191 @@
+//  ssao and bilateral blur fused into one compute dispatch.
+//
+//  every workgroup produces a TILE_SIZE x TILE_SIZE tile of blurred ao.
+//  to do so, it computes raw ao for the tile plus a BLUR_RADIUS border,
+//  and keeps view depth for that region plus a further TAP_APRON border
+//  in shared memory. kernel taps that land inside it are read from shared
+//  memory, the others go to the texture (or the hi-z pyramid).
+//
+//  the apron is fixed by shared memory, not sized from the kernel: a
+//  kernel of the default radius (0.5) spans on the order of a hundred
+//  pixels at 1080p, so only its short taps hit the apron, and most taps
+//  still read the texture. every group loads Z_SIZE^2 depths (52x52, about
+//  ten times the texels it outputs) for that. the gain of this path is
+//  mostly the fused blur, which saves the blur passes and their round trip
+//  through memory; taps only profit where the kernel is small on screen.
+
+#define TILE_SIZE 16
+#ifndef BLUR_RADIUS
+#define BLUR_RADIUS 2
+#endif
+#ifndef TAP_APRON
+#define TAP_APRON 16
+#endif
+
+#define AO_SIZE (TILE_SIZE + 2 * BLUR_RADIUS)
+#define Z_SIZE (AO_SIZE + 2 * TAP_APRON)
+#define GROUP_THREADS (TILE_SIZE * TILE_SIZE)
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+#ifdef HIZ
+#include "hiz.glsl"
+#endif
+
+uniform sampler2D g_normal;
+uniform sampler2D noise_texture;
+
+//  the compact layout stores ao as unorm bytes
+#ifdef COMPACT_GBUFFER
+layout(r8, binding = 0) uniform writeonly image2D ssao_image;
+#else
+layout(r16f, binding = 0) uniform writeonly image2D ssao_image;
+#endif
+
+//  the hemisphere kernel, uploaded once
+layout(std140) uniform SSAOKernel
+{
+    vec4 sampling_points[64];
+};
+
+//  SSAO parameters
+#ifndef SAMPLE_COUNT
+#define SAMPLE_COUNT 64
+#endif
+uniform float radius;
+uniform float bias;
+
+//  tile noise texture over screen based on screen dimensions divided by noise size
+uniform vec2 noiseScale;
+
+
+//  how fast blur weights fall off with relative depth difference and normal angle
+uniform float depth_sharpness;
+uniform float normal_power;
+
+shared float s_z[Z_SIZE * Z_SIZE];       // view depth of ao region + apron
+shared vec3 s_normal[AO_SIZE * AO_SIZE]; // normals of ao region
+shared float s_ao[AO_SIZE * AO_SIZE];    // raw ao of ao region
+shared float s_blur[AO_SIZE * TILE_SIZE];// horizontally blurred ao
+
+float bilateral_weight(int offset, float z, vec3 N, float sampleZ, vec3 sampleN)
+{
+    float sigma = max(float(BLUR_RADIUS) * 0.5, 0.5);
+    float depthDiff = abs(sampleZ - z) / max(abs(z), 1e-3);
+    return exp(-0.5 * float(offset * offset) / (sigma * sigma))
+        * exp(-depthDiff * depth_sharpness)
+        * pow(max(dot(sampleN, N), 0.0), normal_power);
+}
+
+//  view depth at ao region coordinate
+float ao_region_z(ivec2 p)
+{
+    return s_z[(p.y + TAP_APRON) * Z_SIZE + p.x + TAP_APRON];
+}
+
+void main()
+{
+    ivec2 size = imageSize(ssao_image);
+    vec2 invSize = 1.0 / vec2(size);
+    int thread = int(gl_LocalInvocationIndex);
+
+    ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * TILE_SIZE;
+    ivec2 aoOrigin = tileOrigin - BLUR_RADIUS;
+    ivec2 zOrigin = aoOrigin - TAP_APRON;
+
+    //  load view depth and normals into shared memory
+    for (int i = thread; i < Z_SIZE * Z_SIZE; i += GROUP_THREADS)
+    {
+        ivec2 texel = zOrigin + ivec2(i % Z_SIZE, i / Z_SIZE);
+        s_z[i] = gbuffer_view_z((vec2(texel) + 0.5) * invSize);
+    }
+    for (int i = thread; i < AO_SIZE * AO_SIZE; i += GROUP_THREADS)
+    {
+        ivec2 texel = aoOrigin + ivec2(i % AO_SIZE, i / AO_SIZE);
+        s_normal[i] = gbuffer_normal(g_normal, (vec2(texel) + 0.5) * invSize);
+    }
+    barrier();
+
+    //  raw ao of the tile and its blur border
+    for (int i = thread; i < AO_SIZE * AO_SIZE; i += GROUP_THREADS)
+    {
+        ivec2 texel = aoOrigin + ivec2(i % AO_SIZE, i / AO_SIZE);
+        vec2 uv = (vec2(texel) + 0.5) * invSize;
+
+        vec3 fragPos = gbuffer_position(uv);
+        vec3 normal = normalize(s_normal[i]);
+        vec3 randomVec = normalize(texture(noise_texture, uv * noiseScale).xyz);
+
+        //  create TBN change-of-basis matrix: from tangent-space to view-space
+        vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+        vec3 bitangent = cross(normal, tangent);
+        mat3 TBN = mat3(tangent, bitangent, normal);
+
+        float occlusion = 0.0;
+        for (int k = 0; k < SAMPLE_COUNT; ++k)
+        {
+            vec3 sample_pos = fragPos + (TBN * sampling_points[k * (64 / SAMPLE_COUNT)].xyz) * radius;
+
+            vec4 offset = projection_matrix * vec4(sample_pos, 1.0);
+            offset.xy = (offset.xy / offset.w) * 0.5 + 0.5;
+
+            //  shared memory if the tap lands in the apron, texture otherwise
+            ivec2 local = ivec2(floor(offset.xy * vec2(size))) - zOrigin;
+            float sampleDepth;
+            if (all(greaterThanEqual(local, ivec2(0))) && all(lessThan(local, ivec2(Z_SIZE))))
+                sampleDepth = s_z[local.y * Z_SIZE + local.x];
+            else
+#ifdef HIZ
+                sampleDepth = hiz_view_z(offset.xy, length((offset.xy - uv) * vec2(size)));
+#else
+                sampleDepth = gbuffer_view_z(offset.xy);
+#endif
+
+            float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
+            occlusion += (sampleDepth >= sample_pos.z + bias ? 1.0 : 0.0) * rangeCheck;
+        }
+        s_ao[i] = 1.0 - (occlusion / SAMPLE_COUNT);
+    }
+    barrier();
+
+    //  horizontal blur of all rows of the ao region, tile columns only
+    for (int i = thread; i < AO_SIZE * TILE_SIZE; i += GROUP_THREADS)
+    {
+        ivec2 p = ivec2(i % TILE_SIZE + BLUR_RADIUS, i / TILE_SIZE);
+        float z = ao_region_z(p);
+        vec3 N = s_normal[p.y * AO_SIZE + p.x];
+
+        float result = 0.0, weightSum = 0.0;
+        for (int k = -BLUR_RADIUS; k <= BLUR_RADIUS; k++)
+        {
+            ivec2 q = p + ivec2(k, 0);
+            float weight = bilateral_weight(k, z, N, ao_region_z(q), s_normal[q.y * AO_SIZE + q.x]);
+            result += s_ao[q.y * AO_SIZE + q.x] * weight;
+            weightSum += weight;
+        }
+        s_blur[i] = result / max(weightSum, 1e-4);
+    }
+    barrier();
+
+    //  vertical blur, one tile pixel per thread
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    ivec2 p = local + BLUR_RADIUS;
+    float z = ao_region_z(p);
+    vec3 N = s_normal[p.y * AO_SIZE + p.x];
+
+    float result = 0.0, weightSum = 0.0;
+    for (int k = -BLUR_RADIUS; k <= BLUR_RADIUS; k++)
+    {
+        ivec2 q = p + ivec2(0, k);
+        float weight = bilateral_weight(k, z, N, ao_region_z(q), s_normal[q.y * AO_SIZE + q.x]);
+        result += s_blur[q.y * TILE_SIZE + local.x] * weight;
+        weightSum += weight;
+    }
+
+    ivec2 texel = tileOrigin + local;
+    if (all(lessThan(texel, size)))
+        imageStore(ssao_image, texel, vec4(result / max(weightSum, 1e-4)));
+}
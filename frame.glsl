@@ -0,0 +1,18 @@
+//  constants of the frame, shared by all programs. written once per frame
+//  into a uniform buffer, see SSAORenderer::FrameConstants for the layout.
+layout(std140) uniform FrameConstants
+{
+    mat4 projection_matrix;
+    mat4 inverse_projection_matrix;
+    mat4 view_matrix;
+    mat4 prev_projection_matrix;    // of the previous frame, for motion vectors
+    mat4 prev_view_matrix;
+    mat4 shadow_matrix;             // world to the first cascade's clip space
+    mat4 view_to_shadow_matrix[4];  // view to each cascade's clip space
+    vec4 cascade_far;               // view depth each cascade reaches
+    vec4 shadow_bias_unit;          // a texel of each cascade, in depth units
+    vec3 light_dir;                 // normalized
+    float kd;
+    float ks;
+    float shininess;
+};
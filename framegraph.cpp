@@ -0,0 +1,224 @@
+#include "cgbase/cgtools.hpp"
+
+#include "framegraph.hpp"
+
+//  marks cached state as unknown
+static const GLuint UNKNOWN = 0xffffffffu;
+
+FrameGraph::FrameGraph() :
+    _initialized(false),
+    _stateChanges(0), _skippedStateChanges(0)
+{
+    this->invalidateState();
+}
+
+void FrameGraph::invalidateState()
+{
+    this->_framebuffer = this->_program = this->_vertexArray = UNKNOWN;
+    for (int unit = 0; unit < TEXTURE_UNITS; unit++)
+        this->_textures[unit] = UNKNOWN;
+    this->_viewportWidth = this->_viewportHeight = -1;
+    this->_depthTest = -1;
+}
+
+void FrameGraph::begin()
+{
+    this->_passes.clear();
+    this->_resources.clear();
+    this->_schedule.clear();
+}
+
+int FrameGraph::resource(const char* name)
+{
+    Resource resource;
+    resource.name = name;
+    resource.writer = -1;
+    resource.output = false;
+    this->_resources.append(resource);
+    return this->_resources.size() - 1;
+}
+
+int FrameGraph::addPass(const char* name, const std::function<void()>& execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.scheduled = false;
+    this->_passes.append(pass);
+    return this->_passes.size() - 1;
+}
+
+void FrameGraph::read(int pass, int resource)
+{
+    this->_passes[pass].reads.append(resource);
+}
+
+void FrameGraph::write(int pass, int resource)
+{
+    this->_passes[pass].writes.append(resource);
+    this->_resources[resource].writer = pass;
+}
+
+void FrameGraph::output(int resource)
+{
+    this->_resources[resource].output = true;
+}
+
+bool FrameGraph::compile()
+{
+    const int passCount = this->_passes.size();
+    this->_schedule.clear();
+
+    //  cull: starting from the writers of the outputs, keep every pass
+    //  that writes something a kept pass reads
+    QVector<int> pending;
+    for (int r = 0; r < this->_resources.size(); r++)
+        if (this->_resources[r].output && this->_resources[r].writer >= 0)
+            pending.append(this->_resources[r].writer);
+    for (int p = 0; p < passCount; p++)
+        this->_passes[p].scheduled = false;
+    while (!pending.isEmpty())
+    {
+        int p = pending.takeLast();
+        if (this->_passes[p].scheduled)
+            continue;
+        this->_passes[p].scheduled = true;
+        const QVector<int>& reads = this->_passes[p].reads;
+        for (int i = 0; i < reads.size(); i++)
+        {
+            int writer = this->_resources[reads[i]].writer;
+            if (writer >= 0 && !this->_passes[writer].scheduled)
+                pending.append(writer);
+        }
+    }
+
+    //  order: repeatedly run the first kept pass whose inputs are all
+    //  written already (a pass may read what it writes itself)
+    QVector<bool> done(passCount, false);
+    int remaining = 0;
+    for (int p = 0; p < passCount; p++)
+        if (this->_passes[p].scheduled)
+            remaining++;
+    while (remaining > 0)
+    {
+        int next = -1;
+        for (int p = 0; p < passCount && next < 0; p++)
+        {
+            if (!this->_passes[p].scheduled || done[p])
+                continue;
+            bool ready = true;
+            const QVector<int>& reads = this->_passes[p].reads;
+            for (int i = 0; i < reads.size() && ready; i++)
+            {
+                int writer = this->_resources[reads[i]].writer;
+                ready = writer < 0 || writer == p || done[writer];
+            }
+            if (ready)
+                next = p;
+        }
+        if (next < 0)
+        {
+            //  cyclic dependencies
+            for (int p = 0; p < passCount; p++)
+                this->_passes[p].scheduled = false;
+            this->_schedule.clear();
+            return false;
+        }
+        done[next] = true;
+        this->_schedule.append(next);
+        remaining--;
+    }
+    return true;
+}
+
+void FrameGraph::execute()
+{
+    if (!this->_initialized)
+    {
+        this->initializeOpenGLFunctions();
+        this->_initialized = true;
+    }
+
+    this->invalidateState();
+    this->_stateChanges = this->_skippedStateChanges = 0;
+    for (int i = 0; i < this->_schedule.size(); i++)
+        this->_passes[this->_schedule[i]].execute();
+    CG_ASSERT_GLCHECK();
+}
+
+void FrameGraph::bindFramebuffer(GLuint framebuffer)
+{
+    if (framebuffer == this->_framebuffer)
+    {
+        this->_skippedStateChanges++;
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    this->_framebuffer = framebuffer;
+    this->_stateChanges++;
+}
+
+void FrameGraph::setViewport(GLsizei width, GLsizei height)
+{
+    if (width == this->_viewportWidth && height == this->_viewportHeight)
+    {
+        this->_skippedStateChanges++;
+        return;
+    }
+    glViewport(0, 0, width, height);
+    this->_viewportWidth = width;
+    this->_viewportHeight = height;
+    this->_stateChanges++;
+}
+
+void FrameGraph::setDepthTest(bool enabled)
+{
+    if (int(enabled) == this->_depthTest)
+    {
+        this->_skippedStateChanges++;
+        return;
+    }
+    if (enabled)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+    this->_depthTest = enabled;
+    this->_stateChanges++;
+}
+
+void FrameGraph::useProgram(QOpenGLShaderProgram& program)
+{
+    if (program.programId() == this->_program)
+    {
+        this->_skippedStateChanges++;
+        return;
+    }
+    program.bind();
+    this->_program = program.programId();
+    this->_stateChanges++;
+}
+
+void FrameGraph::bindTexture(int unit, GLuint texture)
+{
+    if (texture == this->_textures[unit])
+    {
+        this->_skippedStateChanges++;
+        return;
+    }
+    //  binds to the texture's own target, e.g. for texture arrays
+    glBindTextureUnit(unit, texture);
+    this->_textures[unit] = texture;
+    this->_stateChanges++;
+}
+
+void FrameGraph::bindVertexArray(GLuint vertexArray)
+{
+    if (vertexArray == this->_vertexArray)
+    {
+        this->_skippedStateChanges++;
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    this->_vertexArray = vertexArray;
+    this->_stateChanges++;
+}
@@ -0,0 +1,109 @@
+#ifndef FRAMEGRAPH_HPP
+#define FRAMEGRAPH_HPP
+
+#include <functional>
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+
+//  The passes of one frame and the resources they read and write.
+//
+//  Every frame the renderer adds its passes, declares for each of them the
+//  resources it reads and writes, and marks the resources that leave the
+//  frame (e.g. the final image) as outputs. compile() then drops all passes
+//  that contribute nothing to an output, and orders the others so that a
+//  pass runs after the writers of everything it reads. Passes keep the
+//  order they were added in where the dependencies allow it, so that
+//  targets whose textures are shared by lifetime stay valid.
+//
+//  Resources are only names for the dependencies; each one is written by
+//  at most one pass per frame. Resources without a writer (textures that
+//  are set up once, or the previous frame's history) add no dependency.
+//
+//  The graph also caches the GL state the passes set through it, so that
+//  passes bind what they need without knowing what the previous one left
+//  bound, while only the actual changes reach the driver.
+//  All member functions expect the OpenGL context to be current.
+class FrameGraph : protected QOpenGLFunctions_4_5_Core
+{
+private:
+
+    struct Pass
+    {
+        const char* name;
+        std::function<void()> execute;
+        QVector<int> reads, writes;
+        bool scheduled;
+    };
+
+    struct Resource
+    {
+        const char* name;
+        int writer;             // pass writing it, -1 if none
+        bool output;
+    };
+
+    bool _initialized;
+    QVector<Pass> _passes;
+    QVector<Resource> _resources;
+    QVector<int> _schedule;     // passes in execution order
+
+    //  cached state, 0xffffffff if unknown
+    enum { TEXTURE_UNITS = 16 };
+    GLuint _framebuffer, _program, _vertexArray;
+    GLuint _textures[TEXTURE_UNITS];
+    GLsizei _viewportWidth, _viewportHeight;
+    int _depthTest;             // -1 if unknown
+
+    //  counters of the last frame
+    int _stateChanges, _skippedStateChanges;
+
+    //  forget the cached state, since anything may have happened
+    //  between two frames
+    void invalidateState();
+
+public:
+    FrameGraph();
+
+    //  forget the passes and resources of the previous frame
+    void begin();
+
+    //  a new resource, and a new pass executed by calling execute
+    int resource(const char* name);
+    int addPass(const char* name, const std::function<void()>& execute);
+
+    //  dependencies of a pass
+    void read(int pass, int resource);
+    void write(int pass, int resource);
+
+    //  a resource used after the frame; its writers are never culled
+    void output(int resource);
+
+    //  cull and order the passes. returns false if the dependencies form
+    //  a cycle, in which case nothing is scheduled.
+    bool compile();
+
+    //  run the scheduled passes
+    void execute();
+
+    //  scheduled passes of the compiled frame, in execution order
+    int scheduledPassCount() const { return _schedule.size(); }
+    const char* scheduledPassName(int index) const { return _passes[_schedule[index]].name; }
+    bool isScheduled(int pass) const { return _passes[pass].scheduled; }
+
+    //  state changes passed to the driver, and those skipped because
+    //  the state was already set, during the last execute()
+    int stateChanges() const { return _stateChanges; }
+    int skippedStateChanges() const { return _skippedStateChanges; }
+
+    //  state changes for the passes
+    void bindFramebuffer(GLuint framebuffer);
+    void setViewport(GLsizei width, GLsizei height);
+    void setDepthTest(bool enabled);
+    void useProgram(QOpenGLShaderProgram& program);
+    void bindTexture(int unit, GLuint texture);
+    void bindVertexArray(GLuint vertexArray);
+};
+
+#endif
@@ -0,0 +1,68 @@
+//  one level of the view depth/normal pyramid for reduced resolution ssao.
+//  of every 2x2 block the texel closest to the camera is kept (depth and
+//  normal of the same texel, so that both stay consistent). normals are
+//  copied in their stored encoding, see normal.glsl.
+#ifdef FROM_GBUFFER
+#include "frame.glsl"
+#include "gbuffer.glsl"
+uniform sampler2D g_normal;
+#else
+uniform sampler2D source_view_z;
+uniform sampler2D source_normal;
+#endif
+
+layout(location = 0) out float view_z;
+#ifdef COMPACT_GBUFFER
+layout(location = 1) out vec2 normal;
+#else
+layout(location = 1) out vec3 normal;
+#endif
+
+void main()
+{
+#ifdef FROM_GBUFFER
+    ivec2 sourceSize = textureSize(g_normal, 0);
+#else
+    ivec2 sourceSize = textureSize(source_view_z, 0);
+#endif
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+
+    float bestZ = 0.0;
+#ifdef COMPACT_GBUFFER
+    vec2 bestNormal = vec2(0.5, 0.5);
+#else
+    vec3 bestNormal = vec3(0.0, 0.0, 1.0);
+#endif
+    bool found = false;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 texel = min(base + ivec2(i & 1, i >> 1), sourceSize - 1);
+#ifdef FROM_GBUFFER
+        vec2 uv = (vec2(texel) + 0.5) / vec2(sourceSize);
+        if (gbuffer_background(uv))
+            continue;
+        float z = gbuffer_view_z(uv);
+        vec4 n = texelFetch(g_normal, texel, 0);
+#else
+        //  zero where there is no geometry
+        float z = texelFetch(source_view_z, texel, 0).r;
+        if (z >= 0.0)
+            continue;
+        vec4 n = texelFetch(source_normal, texel, 0);
+#endif
+        if (!found || z > bestZ)
+        {
+            bestZ = z;
+#ifdef COMPACT_GBUFFER
+            bestNormal = n.xy;
+#else
+            bestNormal = n.xyz;
+#endif
+            found = true;
+        }
+    }
+
+    //  stays zero if all four texels are background
+    view_z = bestZ;
+    normal = bestNormal;
+}
@@ -1,27 +1,60 @@
-//  const vec3 surface_color = vec3(0.8, 0.8, 1.0); //  uncomment for fixed albedo color
-uniform vec3 surface_color;
+#include "normal.glsl"
 
 smooth in vec3 vposition;  // position in eye space
 smooth in vec3 vnormal;    // normal in eye space, not normalized
+flat in vec3 vcolor;       // albedo of the instance
+#ifndef SHADOW_FROM_POSITION
 smooth in vec4 vshadowpos;  // view vector in eye space, not normalized
+#endif
 
+#ifdef TEMPORAL
+smooth in vec4 vclippos;      // position in clip space
+smooth in vec4 vprevclippos;  // position in clip space of the previous frame
+smooth in float vprevz;       // view-space z of the previous frame
+#endif
+
+#ifndef RECONSTRUCT_POSITION
 layout(location = 0) out vec3 g_position;
+#endif
+#ifdef COMPACT_GBUFFER
+layout(location = 1) out vec2 g_normal;
+#else
 layout(location = 1) out vec3 g_normal;
+#endif
 layout(location = 2) out vec3 g_albedo;
+#ifndef SHADOW_FROM_POSITION
 layout(location = 3) out vec3 g_shadow;
+#endif
+#ifdef TEMPORAL
+layout(location = 4) out vec3 g_motion;
+#endif
 
 void main()
 {    
     //  store the fragment position vector in the first gbuffer texture
+    //  (unless it is reconstructed from depth later on)
+#ifndef RECONSTRUCT_POSITION
     g_position = vposition;
+#endif
 
     //  also store the per-fragment normals into the gbuffer
-    g_normal = normalize(vnormal);
+    g_normal = encode_normal(normalize(vnormal));
 
     //  and the diffuse per-fragment color
-    g_albedo.rgb = surface_color;
+    g_albedo.rgb = vcolor;
 
     //  don't forget to store clip-space vertex position in shadow pass
-    //  also transform into range [0, 1]
+    //  also transform into range [0, 1]. the compact layout and cascaded
+    //  shadows compute it from the position in the lighting pass instead.
+#ifndef SHADOW_FROM_POSITION
     g_shadow = (vshadowpos.xyz / vshadowpos.w) * 0.5 + 0.5;
+#endif
+
+#ifdef TEMPORAL
+    //  screen-space motion since the previous frame, plus the view-space z
+    //  this point had back then (to detect disocclusions when reprojecting)
+    vec2 uv = vclippos.xy / vclippos.w * 0.5 + 0.5;
+    vec2 prevUV = vprevclippos.xy / vprevclippos.w * 0.5 + 0.5;
+    g_motion = vec3(uv - prevUV, vprevz);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+//  ground-truth ambient occlusion (Jimenez et al. 2016).
+//  for a number of slices through the view vector, the horizons on both
+//  sides of the pixel are searched, and the visible arc between them is
+//  integrated analytically against the cosine-weighted projected normal.
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+#ifdef HIZ
+#include "hiz.glsl"
+#endif
+
+uniform sampler2D g_normal;
+uniform sampler2D noise_texture;
+
+
+#include "horizon.glsl"
+
+//  GTAO parameters: slices and steps per side of a slice, and the part of
+//  the radius over which the weight of occluders falls off to zero
+#ifndef SLICE_COUNT
+#define SLICE_COUNT 2
+#endif
+#ifndef STEP_COUNT
+#define STEP_COUNT 4
+#endif
+uniform float falloff_range;
+uniform float radius;
+
+//  tile noise texture over screen based on screen dimensions divided by noise size
+uniform vec2 noiseScale;
+
+//  per-frame rotation (cos, sin) of the slices
+uniform vec2 noise_rotation;
+
+smooth in vec2 vtexcoord;
+
+layout(location = 0) out float fcolor;
+
+const float PI = 3.14159265;
+const float HALF_PI = 1.57079633;
+
+void main()
+{
+    vec2 size = vec2(textureSize(g_normal, 0));
+    vec3 fragPos = gbuffer_position(vtexcoord);
+    vec3 normal = normalize(gbuffer_normal(g_normal, vtexcoord));
+    vec3 viewVec = normalize(-fragPos);
+
+    float rotation = horizon_rotation(texture(noise_texture, vtexcoord * noiseScale).xyz, noise_rotation);
+    float jitter = horizon_jitter(gl_FragCoord.xy);
+
+    float screenRadius = horizon_screen_radius(radius, fragPos.z, size);
+    //  the first step is at least about one texel away
+    float minS = min(1.3 / max(screenRadius, 1e-4), 1.0);
+
+    //  occluder weight is 1 up to (1 - falloff_range) * radius, 0 at radius
+    float falloffMul = -1.0 / max(falloff_range * radius, 1e-4);
+    float falloffAdd = (1.0 - falloff_range) * radius / max(falloff_range * radius, 1e-4) + 1.0;
+
+    float visibility = 0.0;
+    for (int slice = 0; slice < SLICE_COUNT; ++slice)
+    {
+        //  slices only need to cover half a circle, both sides are searched
+        float phi = rotation + PI * float(slice) / float(SLICE_COUNT);
+        vec2 omega = vec2(cos(phi), sin(phi));
+        vec3 directionVec = vec3(omega, 0.0);
+
+        //  normal projected into the slice plane, and its angle to the view vector
+        vec3 orthoDirectionVec = directionVec - dot(directionVec, viewVec) * viewVec;
+        vec3 axisVec = normalize(cross(orthoDirectionVec, viewVec));
+        vec3 projectedNormal = normal - axisVec * dot(normal, axisVec);
+        float projectedNormalLength = length(projectedNormal);
+        float cosN = clamp(dot(projectedNormal, viewVec) / max(projectedNormalLength, 1e-4), -1.0, 1.0);
+        float n = sign(dot(orthoDirectionVec, projectedNormal)) * acos(cosN);
+
+        //  horizons start at the tangent plane of the projected normal
+        float lowHorizonCos0 = cos(n + HALF_PI);
+        float lowHorizonCos1 = cos(n - HALF_PI);
+        float horizonCos0 = lowHorizonCos0;
+        float horizonCos1 = lowHorizonCos1;
+
+        for (int s = 0; s < STEP_COUNT; ++s)
+        {
+            //  quadratic step distribution, denser near the pixel
+            float t = (float(s) + jitter) / float(STEP_COUNT);
+            t = mix(minS, 1.0, t * t);
+            float screenDistance = t * screenRadius;
+            vec2 offset = omega * screenDistance / size;
+
+            //  both sides, taps outside of the screen do not count
+            for (int side = 0; side < 2; ++side)
+            {
+                vec2 uv = side == 0 ? vtexcoord + offset : vtexcoord - offset;
+                if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+                    continue;
+
+                vec3 delta = horizon_tap_position(uv, screenDistance) - fragPos;
+                float deltaLength = length(delta);
+
+                //  distant occluders fade towards the low horizon
+                float shc = dot(delta / max(deltaLength, 1e-6), viewVec);
+                float weight = clamp(deltaLength * falloffMul + falloffAdd, 0.0, 1.0);
+                if (side == 0)
+                    horizonCos0 = max(horizonCos0, mix(lowHorizonCos0, shc, weight));
+                else
+                    horizonCos1 = max(horizonCos1, mix(lowHorizonCos1, shc, weight));
+            }
+        }
+
+        //  horizon angles, limited to the hemisphere around the projected normal
+        float h0 = -acos(horizonCos1);
+        float h1 = acos(horizonCos0);
+        h0 = n + clamp(h0 - n, -HALF_PI, HALF_PI);
+        h1 = n + clamp(h1 - n, -HALF_PI, HALF_PI);
+
+        //  cosine-weighted visible arc
+        float iarc0 = (cosN + 2.0 * h0 * sin(n) - cos(2.0 * h0 - n)) / 4.0;
+        float iarc1 = (cosN + 2.0 * h1 * sin(n) - cos(2.0 * h1 - n)) / 4.0;
+        visibility += projectedNormalLength * (iarc0 + iarc1);
+    }
+    visibility /= float(SLICE_COUNT);
+
+    fcolor = clamp(visibility, 0.0, 1.0);
+}
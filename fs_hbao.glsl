@@ -0,0 +1,86 @@
+//  horizon-based ambient occlusion (Bavoil et al. 2008).
+//  for a number of screen-space directions around the pixel, the horizon
+//  is traced outwards and every step that raises it adds the attenuated
+//  difference in elevation to the occlusion.
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+#ifdef HIZ
+#include "hiz.glsl"
+#endif
+
+uniform sampler2D g_normal;
+uniform sampler2D noise_texture;
+
+
+#include "horizon.glsl"
+
+//  HBAO parameters: directions and steps per direction, and the minimum
+//  elevation (in radians) above the tangent plane that counts as occluded
+#ifndef DIRECTION_COUNT
+#define DIRECTION_COUNT 8
+#endif
+#ifndef STEP_COUNT
+#define STEP_COUNT 4
+#endif
+uniform float angle_bias;
+uniform float radius;
+
+//  tile noise texture over screen based on screen dimensions divided by noise size
+uniform vec2 noiseScale;
+
+//  per-frame rotation (cos, sin) of the directions
+uniform vec2 noise_rotation;
+
+smooth in vec2 vtexcoord;
+
+layout(location = 0) out float fcolor;
+
+void main()
+{
+    vec2 size = vec2(textureSize(g_normal, 0));
+    vec3 fragPos = gbuffer_position(vtexcoord);
+    vec3 normal = normalize(gbuffer_normal(g_normal, vtexcoord));
+
+    float rotation = horizon_rotation(texture(noise_texture, vtexcoord * noiseScale).xyz, noise_rotation);
+    float jitter = horizon_jitter(gl_FragCoord.xy);
+
+    //  step length in texels, at least one texel per step
+    float screenRadius = horizon_screen_radius(radius, fragPos.z, size);
+    float stepSize = max(screenRadius / float(STEP_COUNT + 1), 1.0);
+    float sinBias = sin(angle_bias);
+    float invRadius2 = 1.0 / (radius * radius);
+
+    float occlusion = 0.0;
+    for (int d = 0; d < DIRECTION_COUNT; ++d)
+    {
+        float angle = rotation + 6.2831853 * float(d) / float(DIRECTION_COUNT);
+        vec2 direction = vec2(cos(angle), sin(angle));
+
+        //  the horizon starts at the (biased) tangent plane
+        float sinHorizon = sinBias;
+        for (int s = 0; s < STEP_COUNT; ++s)
+        {
+            float screenDistance = (float(s) + jitter + 1.0) * stepSize;
+            vec2 uv = vtexcoord + direction * screenDistance / size;
+            if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+                break;
+
+            vec3 V = horizon_tap_position(uv, screenDistance) - fragPos;
+            float VdotV = dot(V, V);
+            float sinElevation = dot(normal, V) * inversesqrt(max(VdotV, 1e-8));
+
+            //  only taps that raise the horizon add occlusion,
+            //  attenuated with the distance to the pixel
+            if (sinElevation > sinHorizon)
+            {
+                float falloff = max(1.0 - VdotV * invRadius2, 0.0);
+                occlusion += (sinElevation - sinHorizon) * falloff;
+                sinHorizon = sinElevation;
+            }
+        }
+    }
+    occlusion /= float(DIRECTION_COUNT);
+
+    fcolor = clamp(1.0 - occlusion, 0.0, 1.0);
+}
@@ -0,0 +1,47 @@
+//  one level of the min/max view depth pyramid (r = farthest, g = closest).
+//  level 0 copies the view depth at ssao resolution, every further level
+//  reduces the previous one, whose texels are read as its level 0 (the
+//  pass restricts the texture to that level while rendering).
+#ifdef FROM_GBUFFER
+#include "frame.glsl"
+#include "gbuffer.glsl"
+uniform vec2 target_size;
+#else
+uniform sampler2D source_hiz;
+#endif
+
+layout(location = 0) out vec2 min_max_z;
+
+void main()
+{
+#ifdef FROM_GBUFFER
+    //  zero marks the background for the coarser levels
+    vec2 uv = gl_FragCoord.xy / target_size;
+    float z = gbuffer_background(uv) ? 0.0 : gbuffer_view_z(uv);
+    min_max_z = vec2(z);
+#else
+    ivec2 sourceSize = textureSize(source_hiz, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+
+    //  with an odd source size, the last texel also covers the third
+    //  row/column, so that no source texel is lost
+    ivec2 last = ivec2(1) + ivec2(equal(base + 2, sourceSize - 1));
+
+    float minZ = 0.0, maxZ = 0.0;
+    bool found = false;
+    for (int y = 0; y <= last.y; ++y)
+    {
+        for (int x = 0; x <= last.x; ++x)
+        {
+            vec2 z = texelFetch(source_hiz, min(base + ivec2(x, y), sourceSize - 1), 0).rg;
+            //  zero where there is no geometry
+            if (z.g >= 0.0)
+                continue;
+            minZ = found ? min(minZ, z.r) : z.r;
+            maxZ = found ? max(maxZ, z.g) : z.g;
+            found = true;
+        }
+    }
+    min_max_z = vec2(minZ, maxZ);
+#endif
+}
@@ -1,20 +1,29 @@
-uniform sampler2D g_position;
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+#include "shadow.glsl"
+
 uniform sampler2D g_normal;
 uniform sampler2D g_albedo;
-uniform sampler2D g_shadow;
 uniform sampler2D ssao_texture;
 
-uniform sampler2D shadow_map;
+//  shadow cascades, one layer of the shadow map each, covering the view
+//  depth up to cascade_far (see frame.glsl). the bias unit is a shadow
+//  map texel in world units, relative to the depth range of the cascade.
+#ifndef SHADOW_CASCADES
+#define SHADOW_CASCADES 1
+#endif
+#ifndef SHADOW_FROM_POSITION
+uniform sampler2D g_shadow;
+#endif
 
-//  representative of vlight, normalized from CPU
-uniform vec3 light_dir; 
+//  point and spot lights, unshadowed, evaluated by cs_lights.glsl
+#ifdef LOCAL_LIGHTS
+uniform sampler2D local_light_texture;
+#endif
 
-//  Variables for lighting (all models)
+//  Variables for lighting (all models); the material is in frame.glsl
 const vec3 light_color = vec3(1.0, 1.0, 1.0);
-uniform float kd;
-uniform float ks;
-//  Variables for Blinn-Phong lighting (isotropic and anisotropic)
-uniform float shininess;
 
 smooth in vec2 vtexcoord;
 
@@ -28,31 +37,11 @@ vec3 blinn_phong(vec3 N, vec3 L, vec3 V, vec3 H)
     return diffuse + specular;
 }
 
-float calculate_shadow(vec3 S, vec3 N, vec3 L)
+float calculate_shadow(vec3 S, vec3 N, vec3 L, int cascade)
 {
-    //  transform ortho coord to proj coord
-    vec3 projCoord = S;
-
-    // get depth of current fragment from light's perspective
-    float currentDepth = projCoord.z;
-
-    float bias = max(0.05 * (1.0 - dot(L, N)), 0.005);
-
-    // check whether current frag pos is in shadow using PCF
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadow_map, 0);
-    for(int x = -1; x <= 1; ++x)
-    {
-        for(int y = -1; y <= 1; ++y)
-        {
-            // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-            float pcfDepth = texture(shadow_map, projCoord.xy + vec2(x, y) * texelSize).r; 
-            shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
-        }
-    }
-    shadow /= 9.0;
-
-    return shadow;
+    //  slope scaled bias, in shadow map texels
+    float bias = max(18.0 * (1.0 - dot(L, N)), 1.8) * shadow_bias_unit[cascade];
+    return shadow_filter(S, cascade, bias);
 }
 
 vec3 calculate_ambient(float aofactor, vec3 albedo)
@@ -63,13 +52,18 @@ vec3 calculate_ambient(float aofactor, vec3 albedo)
 void main(void)
 {
     //  Normalize the input from the vertex shader
-    vec3 N = texture(g_normal, vtexcoord).rgb;
+    vec3 N = gbuffer_normal(g_normal, vtexcoord);
     vec3 L = -light_dir;
-    vec3 V = normalize(-texture(g_position, vtexcoord).rgb); // vector towards the eye
+    vec3 P = gbuffer_position(vtexcoord);
+    vec3 V = normalize(-P); // vector towards the eye
     vec3 H = normalize(L + V);
-    vec3 S = texture(g_shadow, vtexcoord).rgb;
 
+    //  without ao (or shadows) the passes computing it did not run
+#ifdef NO_AO
+    float aofactor = 1.0;
+#else
     float aofactor = texture(ssao_texture, vtexcoord).r;
+#endif
 
     vec3 albedo = texture(g_albedo, vtexcoord).rgb;
 
@@ -77,11 +71,31 @@ void main(void)
     vec3 ambient = calculate_ambient(aofactor, albedo);
 
     //  calculate shadow intensity
-    float shadow = calculate_shadow(S, N, L);
+#ifdef NO_SHADOWS
+    float shadow = 0.0;
+#else
+    //  the first cascade that reaches the fragment's depth
+    int cascade = 0;
+    for (int i = 0; i < SHADOW_CASCADES - 1; i++)
+        if (-P.z > cascade_far[i])
+            cascade = i + 1;
+#ifdef SHADOW_FROM_POSITION
+    vec4 shadowPos = view_to_shadow_matrix[cascade] * vec4(P, 1.0);
+    vec3 S = (shadowPos.xyz / shadowPos.w) * 0.5 + 0.5;
+#else
+    vec3 S = texture(g_shadow, vtexcoord).rgb;
+#endif
+    float shadow = calculate_shadow(S, N, L, cascade);
+#endif
 
     //  Evaluate the lighting model
     vec3 color = blinn_phong(N, L, V, H);
+#ifdef LOCAL_LIGHTS
+    vec3 local = texture(local_light_texture, vtexcoord).rgb;
+#else
+    vec3 local = vec3(0.0);
+#endif
 
     //  Resulting color at this fragment:
-    fcolor = vec4(albedo * ((1.0 - shadow) * color + ambient), 1.0);
+    fcolor = vec4(albedo * ((1.0 - shadow) * color + local + ambient), 1.0);
 }
\ No newline at end of file
@@ -1,29 +1,103 @@
-uniform sampler2D g_position;
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+#ifdef HIZ
+#include "hiz.glsl"
+#endif
+
 uniform sampler2D g_normal;
 uniform sampler2D noise_texture;
 
-uniform vec3 sampling_points[64];
+//  the hemisphere kernel, uploaded once
+layout(std140) uniform SSAOKernel
+{
+    vec4 sampling_points[64];
+};
+
+//  subset of the kernel used in this frame: SAMPLE_COUNT points,
+//  starting at sample_offset with a stride of sample_stride.
+//  temporal accumulation uses a different subset every frame.
+#ifndef SAMPLE_COUNT
+#define SAMPLE_COUNT 64
+#endif
+uniform int sample_stride;
+uniform int sample_offset;
+
+//  per-frame rotation (cos, sin) of the noise vectors around the normal
+uniform vec2 noise_rotation;
 
 //  SSAO parameters
-const int kernelSize = 64;
-const float radius = 0.5;
-const float bias = 0.025;
+uniform float radius;
+uniform float bias;
 
 //  tile noise texture over screen based on screen dimensions divided by noise size
 uniform vec2 noiseScale; 
 
-uniform mat4 projection_matrix;
 
 smooth in vec2 vtexcoord;
 
 layout(location = 0) out float fcolor;
 
+#ifdef ADAPTIVE_SAMPLES
+//  taps taken at this pixel, averaged by the renderer
+layout(location = 1) out float fsamples;
+
+//  screen-space kernel radius in pixels from which on all taps are taken;
+//  smaller kernels cover few texels, and fewer taps find the same
+#define ADAPTIVE_FULL_RADIUS 32.0
+
+//  variance of the first round's occlusion below which the pixel counts
+//  as fully open or fully occluded: zero or all of its taps occluded
+#define ADAPTIVE_VARIANCE 0.03
+#endif
+
+//  occlusion of kernel point i (0 or the range check)
+float ssao_tap(int i, vec3 fragPos, mat3 TBN)
+{
+    //  get sample position
+    vec3 sample_pos = TBN * sampling_points[sample_offset + i * sample_stride].xyz; // from tangent to view-space
+    sample_pos = fragPos + sample_pos * radius; 
+    
+    //  project sample position (to sample texture) (to get position on screen/texture)
+    vec4 offset = vec4(sample_pos, 1.0);
+    offset = projection_matrix * offset; // from view to clip-space
+    offset.xyz /= offset.w; // perspective divide
+    offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
+    
+    //  get sample depth
+#ifdef HIZ
+    //  distant taps read a coarser level of the depth pyramid
+    float screenDistance = length((offset.xy - vtexcoord) * vec2(textureSize(hiz_texture, 0)));
+    float sampleDepth = hiz_view_z(offset.xy, screenDistance);
+#else
+    float sampleDepth = gbuffer_view_z(offset.xy); // get depth value of kernel sample
+#endif
+    
+    //  range check
+    float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
+    return (sampleDepth >= sample_pos.z + bias ? 1.0 : 0.0) * rangeCheck;
+}
+
 void main()
 {
+#ifdef ADAPTIVE_SAMPLES
+    //  where the stencil cannot reject the background, at least no taps
+    if (gbuffer_background(vtexcoord))
+    {
+        fcolor = 1.0;
+        fsamples = 0.0;
+        return;
+    }
+#endif
+
     //  get input for SSAO algorithm
-    vec3 fragPos = texture(g_position, vtexcoord).xyz;
-    vec3 normal = normalize(texture(g_normal, vtexcoord).rgb);
-    vec3 randomVec = normalize(texture(noise_texture, vtexcoord * noiseScale).xyz);
+    vec3 fragPos = gbuffer_position(vtexcoord);
+    vec3 normal = normalize(gbuffer_normal(g_normal, vtexcoord));
+    vec3 randomVec = texture(noise_texture, vtexcoord * noiseScale).xyz;
+    randomVec = normalize(vec3(
+        noise_rotation.x * randomVec.x - noise_rotation.y * randomVec.y,
+        noise_rotation.y * randomVec.x + noise_rotation.x * randomVec.y,
+        0.0));
 
     //  create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -32,26 +106,35 @@ void main()
 
     //  iterate over the sample kernel and calculate occlusion factor
     float occlusion = 0.0;
-    for(int i = 0; i < kernelSize; ++i)
+#ifdef ADAPTIVE_SAMPLES
+    //  the taps are taken in four interleaved rounds (every fourth point,
+    //  starting at 0, 2, 1 and 3), so that any number of rounds spans the
+    //  whole kernel. pixels whose first round finds them fully open or
+    //  fully occluded stop there; the others take as many rounds as the
+    //  size of their kernel on screen warrants.
+    float pixelRadius = radius * projection_matrix[1][1] * 0.5 * float(textureSize(g_normal, 0).y)
+        / max(-fragPos.z, 1e-4);
+    int rounds = int(clamp(ceil(4.0 * pixelRadius / ADAPTIVE_FULL_RADIUS), 1.0, 4.0));
+    const int roundStart[4] = int[4](0, 2, 1, 3);
+    int taps = 0;
+    for (int stage = 0; stage < rounds; ++stage)
     {
-        //  get sample position
-        vec3 sample_pos = TBN * sampling_points[i]; // from tangent to view-space
-        sample_pos = fragPos + sample_pos * radius; 
-        
-        //  project sample position (to sample texture) (to get position on screen/texture)
-        vec4 offset = vec4(sample_pos, 1.0);
-        offset = projection_matrix * offset; // from view to clip-space
-        offset.xyz /= offset.w; // perspective divide
-        offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
-        
-        //  get sample depth
-        float sampleDepth = texture(g_position, offset.xy).z; // get depth value of kernel sample
-        
-        //  range check & accumulate
-        float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
-        occlusion += (sampleDepth >= sample_pos.z + bias ? 1.0 : 0.0) * rangeCheck;           
+        for (int i = roundStart[stage]; i < SAMPLE_COUNT; i += 4)
+        {
+            occlusion += ssao_tap(i, fragPos, TBN);
+            ++taps;
+        }
+        float p = occlusion / float(taps);
+        if (stage == 0 && p * (1.0 - p) < ADAPTIVE_VARIANCE)
+            break;
     }
-    occlusion = 1.0 - (occlusion / kernelSize);
+    occlusion = 1.0 - (occlusion / float(taps));
+    fsamples = float(taps);
+#else
+    for(int i = 0; i < SAMPLE_COUNT; ++i)
+        occlusion += ssao_tap(i, fragPos, TBN);
+    occlusion = 1.0 - (occlusion / SAMPLE_COUNT);
+#endif
     
     fcolor = occlusion;
-}
\ No newline at end of file
+}
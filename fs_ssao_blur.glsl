@@ -1,4 +1,22 @@
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+
 uniform sampler2D ssao_texture;
+uniform sampler2D g_normal;
+
+//  one texel step along the blur direction, i.e. (1/width, 0) for the
+//  horizontal and (0, 1/height) for the vertical pass
+uniform vec2 blur_direction;
+
+//  texels per direction, compiled in so that the loop can be unrolled
+#ifndef BLUR_RADIUS
+#define BLUR_RADIUS 2
+#endif
+
+//  how fast weights fall off with relative depth difference and normal angle
+uniform float depth_sharpness;
+uniform float normal_power;
 
 smooth in vec2 vtexcoord;
 
@@ -6,18 +24,32 @@ layout(location = 0) out float fcolor;
 
 void main() 
 {
-    //  calculate texel size
-    vec2 texelSize = 1.0 / vec2(textureSize(ssao_texture, 0));
+    float z = gbuffer_view_z(vtexcoord);
+    vec3 N = gbuffer_normal(g_normal, vtexcoord);
 
-    //  apply low-pass filter (blur)
-    float result = 0.0;
-    for (int x = -2; x < 2; x++) 
+    //  gaussian falloff over the radius
+    float sigma = max(float(BLUR_RADIUS) * 0.5, 0.5);
+    float gaussianFactor = -0.5 / (sigma * sigma);
+
+    //  apply low-pass filter (blur) along one direction, but only over
+    //  texels of the same surface, so that ao does not bleed over edges
+    float result = texture(ssao_texture, vtexcoord).r;
+    float weightSum = 1.0;
+    for (int i = -BLUR_RADIUS; i <= BLUR_RADIUS; i++) 
     {
-        for (int y = -2; y < 2; y++) 
-        {
-            vec2 offset = vec2(float(x), float(y)) * texelSize;
-            result += texture(ssao_texture, vtexcoord + offset).r;
-        }
+        if (i == 0)
+            continue;
+        vec2 uv = vtexcoord + float(i) * blur_direction;
+        float sampleZ = gbuffer_view_z(uv);
+        vec3 sampleN = gbuffer_normal(g_normal, uv);
+
+        float depthDiff = abs(sampleZ - z) / max(abs(z), 1e-3);
+        float weight = exp(float(i * i) * gaussianFactor)
+            * exp(-depthDiff * depth_sharpness)
+            * pow(max(dot(sampleN, N), 0.0), normal_power);
+
+        result += texture(ssao_texture, uv).r * weight;
+        weightSum += weight;
     }
-    fcolor = result / (4.0 * 4.0);
-} 
\ No newline at end of file
+    fcolor = result / weightSum;
+}
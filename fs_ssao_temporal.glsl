@@ -0,0 +1,49 @@
+#include "frame.glsl"
+#include "gbuffer.glsl"
+
+//  this frame's ssao (few samples, noisy)
+uniform sampler2D ssao_texture;
+//  accumulated ssao (r) and the view-space z it belongs to (g)
+uniform sampler2D history_texture;
+//  screen-space motion (xy) and view-space z in the previous frame (z)
+uniform sampler2D g_motion;
+
+//  false after a reset, e.g. when the targets were reallocated
+uniform bool history_valid;
+//  weight of the current frame in the exponential moving average
+uniform float blend_factor;
+//  history is rejected if its depth differs more than this (relative)
+uniform float depth_tolerance;
+
+smooth in vec2 vtexcoord;
+
+layout(location = 0) out vec2 fcolor;
+
+void main()
+{
+    float ao = texture(ssao_texture, vtexcoord).r;
+    float z = gbuffer_view_z(vtexcoord);
+    vec3 motion = texture(g_motion, vtexcoord).xyz;
+
+    //  reproject into the previous frame
+    vec2 prevUV = vtexcoord - motion.xy;
+
+    float alpha = 1.0;
+    float history = ao;
+    if (history_valid
+        && all(greaterThanEqual(prevUV, vec2(0.0)))
+        && all(lessThanEqual(prevUV, vec2(1.0))))
+    {
+        vec2 previous = texture(history_texture, prevUV).rg;
+
+        //  the surface seen there in the previous frame must be the one we
+        //  see now, otherwise it was disoccluded and the history is invalid
+        if (abs(previous.g - motion.z) <= depth_tolerance * abs(motion.z))
+        {
+            alpha = blend_factor;
+            history = previous.r;
+        }
+    }
+
+    fcolor = vec2(mix(history, ao, alpha), z);
+}
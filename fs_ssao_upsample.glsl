@@ -0,0 +1,61 @@
+#include "frame.glsl"
+#include "gbuffer.glsl"
+#include "normal.glsl"
+
+uniform sampler2D g_normal;
+
+//  reduced resolution ssao and the view depth/normals it was computed from
+uniform sampler2D ssao_texture;
+uniform sampler2D low_view_z;
+uniform sampler2D low_normal;
+
+//  how fast weights fall off with relative depth difference and normal angle
+const float depthSharpness = 32.0;
+const float normalPower = 8.0;
+
+smooth in vec2 vtexcoord;
+
+layout(location = 0) out float fcolor;
+
+void main()
+{
+    float z = gbuffer_view_z(vtexcoord);
+    vec3 N = gbuffer_normal(g_normal, vtexcoord);
+
+    //  the four low resolution texels around this pixel
+    vec2 lowSize = vec2(textureSize(ssao_texture, 0));
+    vec2 st = vtexcoord * lowSize - 0.5;
+    ivec2 base = ivec2(floor(st));
+    vec2 f = st - vec2(base);
+
+    //  joint bilateral weights: bilinear * depth similarity * normal similarity
+    float result = 0.0;
+    float weightSum = 0.0;
+    float closestAO = 1.0;
+    float closestDiff = 1e30;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), ivec2(lowSize) - 1);
+        float lowZ = texelFetch(low_view_z, texel, 0).r;
+        vec3 lowN = gbuffer_normal_texel(low_normal, texel);
+        float ao = texelFetch(ssao_texture, texel, 0).r;
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float depthDiff = abs(lowZ - z) / max(abs(z), 1e-3);
+        float weight = bilinear.x * bilinear.y
+            * exp(-depthDiff * depthSharpness)
+            * pow(max(dot(lowN, N), 0.0), normalPower);
+
+        result += ao * weight;
+        weightSum += weight;
+        if (depthDiff < closestDiff)
+        {
+            closestDiff = depthDiff;
+            closestAO = ao;
+        }
+    }
+
+    //  no texel on the same surface: take the one closest in depth
+    fcolor = weightSum > 1e-4 ? result / weightSum : closestAO;
+}
@@ -0,0 +1,77 @@
+//  access to the view-space position stored in the g-buffer.
+//  with RECONSTRUCT_POSITION the position is not stored at all, but
+//  reconstructed from the depth buffer and the inverse projection.
+//  with GBUFFER_VIEW_Z it is reconstructed from a linear view depth
+//  texture, as used for reduced resolution ssao.
+//  expects frame.glsl.
+#if defined(GBUFFER_VIEW_Z)
+uniform sampler2D g_view_z;
+
+//  view-space position at texture coordinate uv
+vec3 gbuffer_position(vec2 uv)
+{
+    //  scale the view ray through uv to the stored depth
+    vec4 ray = inverse_projection_matrix * vec4(uv * 2.0 - 1.0, 1.0, 1.0);
+    return ray.xyz * (texture(g_view_z, uv).r / ray.z);
+}
+
+//  only the view-space z at texture coordinate uv
+float gbuffer_view_z(vec2 uv)
+{
+    return texture(g_view_z, uv).r;
+}
+
+//  whether nothing was drawn at uv (the pyramid stores zero there)
+bool gbuffer_background(vec2 uv)
+{
+    return texture(g_view_z, uv).r >= 0.0;
+}
+#elif defined(RECONSTRUCT_POSITION)
+uniform sampler2D g_depth;
+
+//  view-space position at texture coordinate uv
+vec3 gbuffer_position(vec2 uv)
+{
+    float depth = texture(g_depth, uv).r;
+    vec4 position = inverse_projection_matrix * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
+//  only the view-space z at texture coordinate uv (two rows of the matrix)
+float gbuffer_view_z(vec2 uv)
+{
+    float depth = texture(g_depth, uv).r;
+    vec4 ndc = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 row_z = vec4(inverse_projection_matrix[0][2], inverse_projection_matrix[1][2],
+        inverse_projection_matrix[2][2], inverse_projection_matrix[3][2]);
+    vec4 row_w = vec4(inverse_projection_matrix[0][3], inverse_projection_matrix[1][3],
+        inverse_projection_matrix[2][3], inverse_projection_matrix[3][3]);
+    return dot(row_z, ndc) / dot(row_w, ndc);
+}
+
+//  whether nothing was drawn at uv (the depth buffer is cleared to one)
+bool gbuffer_background(vec2 uv)
+{
+    return texture(g_depth, uv).r == 1.0;
+}
+#else
+uniform sampler2D g_position;
+
+//  view-space position at texture coordinate uv
+vec3 gbuffer_position(vec2 uv)
+{
+    return texture(g_position, uv).xyz;
+}
+
+//  only the view-space z at texture coordinate uv
+float gbuffer_view_z(vec2 uv)
+{
+    return texture(g_position, uv).z;
+}
+
+//  whether nothing was drawn at uv (the position buffer is cleared to zero)
+bool gbuffer_background(vec2 uv)
+{
+    return texture(g_position, uv).z >= 0.0;
+}
+#endif
@@ -0,0 +1,20 @@
+//  access to the min/max view depth pyramid (r = farthest, g = closest).
+//  kernel taps that land far from the pixel are read from a coarser level,
+//  so that all taps of a pixel hit a similarly small set of cache lines.
+
+uniform sampler2D hiz_texture;
+uniform int hiz_max_level;
+
+//  taps less than 2^HIZ_LOG_CACHE_TEXELS texels away read level 0, and
+//  every doubling of the distance one level coarser
+#define HIZ_LOG_CACHE_TEXELS 3
+
+//  view-space z closest to the camera around texture coordinate uv,
+//  for a tap screenDistance texels (at level 0) away from its pixel
+float hiz_view_z(vec2 uv, float screenDistance)
+{
+    int level = clamp(findMSB(int(screenDistance)) - HIZ_LOG_CACHE_TEXELS + 1, 0, hiz_max_level);
+    ivec2 size = textureSize(hiz_texture, level);
+    ivec2 texel = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+    return texelFetch(hiz_texture, texel, level).g;
+}
@@ -0,0 +1,39 @@
+//  helpers shared by the horizon-based ao techniques (hbao, gtao).
+//  they march along screen-space directions, so they need the view-space
+//  position of arbitrary taps, the kernel radius in texels and a per-pixel
+//  rotation and jitter.
+//  expects gbuffer.glsl (and hiz.glsl with HIZ) and projection_matrix.
+
+//  view-space position at texture coordinate uv, for a tap screenDistance
+//  texels away from its pixel
+vec3 horizon_tap_position(vec2 uv, float screenDistance)
+{
+#ifdef HIZ
+    //  only z is stored in the pyramid, x and y follow from the projection
+    float z = hiz_view_z(uv, screenDistance);
+    vec2 ndc = uv * 2.0 - 1.0;
+    return vec3((ndc * -z - projection_matrix[2].xy * z)
+        / vec2(projection_matrix[0][0], projection_matrix[1][1]), z);
+#else
+    return gbuffer_position(uv);
+#endif
+}
+
+//  world-space radius projected to texels at view depth z
+float horizon_screen_radius(float radius, float z, vec2 size)
+{
+    return radius * projection_matrix[1][1] * 0.5 * size.y / max(-z, 1e-4);
+}
+
+//  rotation of the march directions: the angle of the tiled noise vector,
+//  turned further by the per-frame rotation
+float horizon_rotation(vec3 noise, vec2 frameRotation)
+{
+    return atan(noise.y, noise.x) + atan(frameRotation.y, frameRotation.x);
+}
+
+//  per-pixel offset of the first step in [0, 1) (interleaved gradient noise)
+float horizon_jitter(vec2 fragCoord)
+{
+    return fract(52.9829189 * fract(dot(fragCoord, vec2(0.06711056, 0.00583715))));
+}
@@ -0,0 +1,572 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "meshfile.hpp"
+
+//  cache the triangle order is optimized for; larger than most hardware
+//  caches, which the order still suits (Forsyth)
+#define OPTIMIZE_CACHE_SIZE 32
+
+//  cache of the overdraw clustering, and how much worse than its hard
+//  cluster a soft cluster's miss ratio may be (Sander et al. use 1.05)
+#define OVERDRAW_CACHE_SIZE 16
+#define OVERDRAW_THRESHOLD 1.05f
+
+//  sections of the file start at multiples of this
+#define MESH_FILE_ALIGNMENT 16
+
+static const char meshFileMagic[8] = { 'S', 'S', 'A', 'O', 'M', 'E', 'S', 'H' };
+
+static quint32 aligned(quint32 offset)
+{
+    return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+MeshFile::MeshFile() :
+    _data(NULL), _header(NULL)
+{
+}
+
+MeshFile::~MeshFile()
+{
+    this->close();
+}
+
+bool MeshFile::open(const QString& fileName)
+{
+    this->close();
+    this->_file.setFileName(fileName);
+    if (!this->_file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 size = this->_file.size();
+    if (size < qint64(sizeof(MeshFileHeader)))
+    {
+        this->close();
+        return false;
+    }
+    this->_data = this->_file.map(0, size);
+    if (!this->_data)
+    {
+        this->close();
+        return false;
+    }
+
+    //  the sections must lie within the file
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(this->_data);
+    bool valid = std::memcmp(header->magic, meshFileMagic, sizeof(meshFileMagic)) == 0
+        && header->version == MESH_FILE_VERSION
+        && (header->indexSize == 2 || header->indexSize == 4)
+        && header->vertexOffset % MESH_FILE_ALIGNMENT == 0
+        && header->indexOffset % MESH_FILE_ALIGNMENT == 0
+        && header->vertexOffset + qint64(header->vertexCount) * qint64(sizeof(MeshFileVertex)) <= size
+        && header->indexOffset + qint64(header->indexCount) * header->indexSize <= size;
+    if (!valid)
+    {
+        this->close();
+        return false;
+    }
+    this->_header = header;
+    return true;
+}
+
+void MeshFile::close()
+{
+    if (this->_data)
+        this->_file.unmap(this->_data);
+    this->_data = NULL;
+    this->_header = NULL;
+    this->_file.close();
+}
+
+const MeshFileVertex* MeshFile::vertices() const
+{
+    return reinterpret_cast<const MeshFileVertex*>(this->_data + this->_header->vertexOffset);
+}
+
+const void* MeshFile::indices() const
+{
+    return this->_data + this->_header->indexOffset;
+}
+
+//  FIFO post-transform cache, counting the vertices a triangle transforms
+struct CacheSimulator
+{
+    std::vector<unsigned int> stamps;   // time each vertex entered the cache
+    unsigned int time;
+    unsigned int size;
+
+    CacheSimulator(int vertexCount, int cacheSize) :
+        stamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize)
+    {
+    }
+
+    //  empty the cache
+    void reset()
+    {
+        time += size + 1;
+    }
+
+    int misses(const unsigned int* triangle)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (time - stamps[triangle[k]] > size)
+            {
+                stamps[triangle[k]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+static int vertexCount(const QVector<unsigned int>& indices)
+{
+    unsigned int count = 0;
+    for (int i = 0; i < indices.size(); i++)
+        count = std::max(count, indices[i] + 1);
+    return int(count);
+}
+
+float averageCacheMissRatio(const QVector<unsigned int>& indices, int cacheSize)
+{
+    int triangles = indices.size() / 3;
+    if (triangles == 0)
+        return 0.0f;
+    CacheSimulator cache(::vertexCount(indices), cacheSize);
+    int misses = 0;
+    for (int t = 0; t < triangles; t++)
+        misses += cache.misses(&indices[3 * t]);
+    return float(misses) / triangles;
+}
+
+//  point indices of equal vertices to the first of them
+static void weldVertices(const QVector<float>& positions, const QVector<float>& normals,
+    const QVector<float>& texCoords, QVector<unsigned int>& indices)
+{
+    const int count = positions.size() / 3;
+    const bool hasNormals = normals.size() == 3 * count;
+    const bool hasTexCoords = texCoords.size() == 2 * count;
+
+    //  all attributes of a vertex, compared as one key
+    std::vector<float> keys(8 * count, 0.0f);
+    for (int v = 0; v < count; v++)
+    {
+        float* key = &keys[8 * v];
+        for (int k = 0; k < 3; k++)
+        {
+            key[k] = positions[3 * v + k];
+            key[3 + k] = hasNormals ? normals[3 * v + k] : 0.0f;
+        }
+        for (int k = 0; k < 2; k++)
+            key[6 + k] = hasTexCoords ? texCoords[2 * v + k] : 0.0f;
+    }
+
+    std::vector<int> order(count);
+    for (int v = 0; v < count; v++)
+        order[v] = v;
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) {
+        return std::lexicographical_compare(&keys[8 * a], &keys[8 * a + 8], &keys[8 * b], &keys[8 * b + 8]);
+    });
+
+    std::vector<unsigned int> remap(count);
+    for (int i = 0; i < count; i++)
+    {
+        int v = order[i];
+        bool same = i > 0 && std::equal(&keys[8 * v], &keys[8 * v + 8], &keys[8 * order[i - 1]]);
+        remap[v] = same ? remap[order[i - 1]] : v;
+    }
+    for (int i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+}
+
+//  score of a vertex for the next triangle: higher the more recently it
+//  was used, and the fewer triangles it has left (Forsyth)
+static float vertexScore(int cachePosition, int remaining)
+{
+    if (remaining == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        //  the last triangle's vertices score a bit lower, so that the next
+        //  triangle does not always continue a strip
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - float(cachePosition - 3) / (OPTIMIZE_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt(float(remaining));
+}
+
+//  greedily emit the triangle with the best vertices in a simulated LRU
+//  cache (Forsyth's linear-speed vertex cache optimisation)
+static void optimizeVertexCache(QVector<unsigned int>& indices, int vertexCount)
+{
+    const int triangleCount = indices.size() / 3;
+
+    //  triangles of each vertex not emitted yet: the first remaining[v]
+    //  entries from offsets[v] on
+    std::vector<int> offsets(vertexCount + 1, 0), remaining(vertexCount, 0);
+    for (int i = 0; i < indices.size(); i++)
+        remaining[indices[i]]++;
+    for (int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<int> vertexTriangles(indices.size());
+    std::vector<int> filled(vertexCount, 0);
+    for (int i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        vertexTriangles[offsets[v] + filled[v]++] = i / 3;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (int v = 0; v < vertexCount; v++)
+        vertexScores[v] = ::vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScores(triangleCount, 0.0f);
+    for (int i = 0; i < indices.size(); i++)
+        triangleScores[i / 3] += vertexScores[indices[i]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<int> cache, newCache;
+    QVector<unsigned int> result;
+    result.reserve(indices.size());
+    int best = -1;
+    int next = 0;   // first triangle that may not be emitted yet
+    for (int n = 0; n < triangleCount; n++)
+    {
+        //  nothing in the cache has triangles left: continue in input order
+        if (best < 0)
+        {
+            while (emitted[next])
+                next++;
+            best = next;
+        }
+
+        const unsigned int* triangle = &indices[3 * best];
+        emitted[best] = true;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            result.append(v);
+            int* list = &vertexTriangles[offsets[v]];
+            int* last = list + remaining[v] - 1;
+            std::iter_swap(std::find(list, last, best), last);
+            remaining[v]--;
+        }
+
+        //  the triangle's vertices move to the front
+        newCache.assign(triangle, triangle + 3);
+        for (size_t i = 0; i < cache.size(); i++)
+            if (cache[i] != int(triangle[0]) && cache[i] != int(triangle[1]) && cache[i] != int(triangle[2]))
+                newCache.push_back(cache[i]);
+
+        //  rescore everything that moved, including what dropped out
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            int v = newCache[i];
+            cachePosition[v] = int(i) < OPTIMIZE_CACHE_SIZE ? int(i) : -1;
+            float score = ::vertexScore(cachePosition[v], remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (int j = 0; j < remaining[v]; j++)
+                triangleScores[vertexTriangles[offsets[v] + j]] += delta;
+        }
+
+        //  the next triangle is the best one touching the cache
+        if (int(newCache.size()) > OPTIMIZE_CACHE_SIZE)
+            newCache.resize(OPTIMIZE_CACHE_SIZE);
+        best = -1;
+        float bestScore = -FLT_MAX;
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            int v = newCache[i];
+            for (int j = 0; j < remaining[v]; j++)
+            {
+                int t = vertexTriangles[offsets[v] + j];
+                if (triangleScores[t] > bestScore)
+                {
+                    best = t;
+                    bestScore = triangleScores[t];
+                }
+            }
+        }
+        cache.swap(newCache);
+    }
+    indices = result;
+}
+
+//  split the triangle order into clusters that keep most of its cache
+//  locality, and draw the clusters facing outwards first, so that they
+//  tend to occlude the rest ("Fast triangle reordering for vertex
+//  locality and reduced overdraw", Sander, Nehab and Barczak 2007)
+static void optimizeOverdraw(QVector<unsigned int>& indices, const QVector<float>& positions)
+{
+    const int triangleCount = indices.size() / 3;
+    const int vertexCount = positions.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    //  hard boundaries: where the cache missed all of a triangle's vertices
+    CacheSimulator cache(vertexCount, OVERDRAW_CACHE_SIZE);
+    std::vector<int> hard;
+    for (int t = 0; t < triangleCount; t++)
+        if (cache.misses(&indices[3 * t]) == 3)
+            hard.push_back(t);
+    hard.push_back(triangleCount);
+    if (hard.front() != 0)
+        hard.insert(hard.begin(), 0);
+
+    //  soft boundaries: a cluster ends as soon as its miss ratio, from a
+    //  cold cache, is close to that of the whole hard cluster
+    std::vector<int> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); h++)
+    {
+        int begin = hard[h], end = hard[h + 1];
+        cache.reset();
+        int misses = 0;
+        for (int t = begin; t < end; t++)
+            misses += cache.misses(&indices[3 * t]);
+        float limit = OVERDRAW_THRESHOLD * misses / (end - begin);
+
+        cache.reset();
+        misses = 0;
+        int start = begin;
+        clusters.push_back(begin);
+        for (int t = begin; t < end; t++)
+        {
+            misses += cache.misses(&indices[3 * t]);
+            if (t + 1 < end && misses <= limit * (t + 1 - start))
+            {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                cache.reset();
+                misses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    //  area weighted centroids and normals, of the mesh and the clusters
+    const int clusterCount = int(clusters.size()) - 1;
+    std::vector<float> centroids(3 * clusterCount, 0.0f), normals(3 * clusterCount, 0.0f);
+    std::vector<float> areas(clusterCount, 0.0f);
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (int c = 0; c < clusterCount; c++)
+    {
+        for (int t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const float* p0 = &positions[3 * indices[3 * t]];
+            const float* p1 = &positions[3 * indices[3 * t + 1]];
+            const float* p2 = &positions[3 * indices[3 * t + 2]];
+            float e1[3], e2[3], n[3];
+            for (int k = 0; k < 3; k++)
+            {
+                e1[k] = p1[k] - p0[k];
+                e2[k] = p2[k] - p0[k];
+            }
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++)
+            {
+                float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                centroids[3 * c + k] += center * area;
+                normals[3 * c + k] += n[k];
+                meshCentroid[k] += center * area;
+            }
+            areas[c] += area;
+            meshArea += area;
+        }
+    }
+    for (int k = 0; k < 3; k++)
+        meshCentroid[k] /= std::max(meshArea, FLT_MIN);
+
+    //  how far out a cluster is, along its normal
+    std::vector<float> keys(clusterCount);
+    for (int c = 0; c < clusterCount; c++)
+    {
+        const float* n = &normals[3 * c];
+        float length = std::max(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]), FLT_MIN);
+        float key = 0.0f;
+        for (int k = 0; k < 3; k++)
+            key += (centroids[3 * c + k] / std::max(areas[c], FLT_MIN) - meshCentroid[k]) * n[k] / length;
+        keys[c] = key;
+    }
+
+    std::vector<int> order(clusterCount);
+    for (int c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] > keys[b]; });
+
+    QVector<unsigned int> result;
+    result.reserve(indices.size());
+    for (int i = 0; i < clusterCount; i++)
+        for (int j = 3 * clusters[order[i]]; j < 3 * clusters[order[i] + 1]; j++)
+            result.append(indices[j]);
+    indices = result;
+}
+
+//  renumber the vertices in order of first use, dropping unused ones
+static void reorderVertices(QVector<float>& positions, QVector<float>& normals,
+    QVector<float>& texCoords, QVector<unsigned int>& indices)
+{
+    const int count = positions.size() / 3;
+    const bool hasNormals = normals.size() == 3 * count;
+    const bool hasTexCoords = texCoords.size() == 2 * count;
+
+    std::vector<int> remap(count, -1);
+    QVector<float> newPositions, newNormals, newTexCoords;
+    int used = 0;
+    for (int i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (remap[v] < 0)
+        {
+            remap[v] = used++;
+            for (int k = 0; k < 3; k++)
+            {
+                newPositions.append(positions[3 * v + k]);
+                if (hasNormals)
+                    newNormals.append(normals[3 * v + k]);
+            }
+            if (hasTexCoords)
+            {
+                newTexCoords.append(texCoords[2 * v]);
+                newTexCoords.append(texCoords[2 * v + 1]);
+            }
+        }
+        indices[i] = remap[v];
+    }
+    positions = newPositions;
+    normals = newNormals;
+    texCoords = newTexCoords;
+}
+
+void optimizeMesh(QVector<float>& positions, QVector<float>& normals,
+    QVector<float>& texCoords, QVector<unsigned int>& indices)
+{
+    ::weldVertices(positions, normals, texCoords, indices);
+    ::optimizeVertexCache(indices, positions.size() / 3);
+    ::optimizeOverdraw(indices, positions);
+    ::reorderVertices(positions, normals, texCoords, indices);
+}
+
+//  IEEE half float, rounded to nearest
+static quint16 floatToHalf(float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    quint32 sign = (bits >> 16) & 0x8000;
+    int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+    quint32 mantissa = bits & 0x7fffff;
+    if (exponent >= 31)
+    {
+        //  too large, infinite or not a number
+        bool nan = (bits & 0x7fffffff) > 0x7f800000;
+        return quint16(sign | 0x7c00 | (nan ? 0x200 : 0));
+    }
+    if (exponent <= 0)
+    {
+        //  subnormal, or too small
+        if (exponent < -10)
+            return quint16(sign);
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        quint32 half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return quint16(sign | half);
+    }
+    //  a carry of the rounding correctly moves into the exponent
+    quint32 half = sign | (quint32(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000)
+        half++;
+    return quint16(half);
+}
+
+//  unit normal as signed normalized 2:10:10:10 with w = 0
+static quint32 packNormal(const float* normal)
+{
+    quint32 packed = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        float c = std::min(std::max(normal[k], -1.0f), 1.0f);
+        qint32 value = qint32(std::floor(c * 511.0f + 0.5f));
+        packed |= (quint32(value) & 0x3ff) << (10 * k);
+    }
+    return packed;
+}
+
+bool writeMeshFile(const QString& fileName, const QVector<float>& positions,
+    const QVector<float>& normals, const QVector<float>& texCoords,
+    const QVector<unsigned int>& indices)
+{
+    const int count = positions.size() / 3;
+    const bool hasNormals = normals.size() == 3 * count;
+    const bool hasTexCoords = texCoords.size() == 2 * count;
+
+    MeshFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, meshFileMagic, sizeof(meshFileMagic));
+    header.version = MESH_FILE_VERSION;
+    header.vertexCount = count;
+    header.indexCount = indices.size();
+    header.indexSize = count <= 65536 ? 2 : 4;
+    header.vertexOffset = ::aligned(sizeof(MeshFileHeader));
+    header.indexOffset = ::aligned(header.vertexOffset + count * sizeof(MeshFileVertex));
+    for (int k = 0; k < 3; k++)
+    {
+        header.min[k] = count > 0 ? FLT_MAX : 0.0f;
+        header.max[k] = count > 0 ? -FLT_MAX : 0.0f;
+    }
+
+    QByteArray data(int(header.indexOffset + header.indexCount * header.indexSize), '\0');
+    MeshFileVertex* vertices = reinterpret_cast<MeshFileVertex*>(data.data() + header.vertexOffset);
+    for (int v = 0; v < count; v++)
+    {
+        const float* p = &positions[3 * v];
+        const float up[3] = { 0.0f, 0.0f, 1.0f };
+        std::memcpy(vertices[v].position, p, sizeof(vertices[v].position));
+        vertices[v].normal = ::packNormal(hasNormals ? &normals[3 * v] : up);
+        for (int k = 0; k < 2; k++)
+            vertices[v].texCoord[k] = ::floatToHalf(hasTexCoords ? texCoords[2 * v + k] : 0.0f);
+        for (int k = 0; k < 3; k++)
+        {
+            header.min[k] = std::min(header.min[k], p[k]);
+            header.max[k] = std::max(header.max[k], p[k]);
+        }
+        header.radius = std::max(header.radius, std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+    }
+    for (int i = 0; i < indices.size(); i++)
+    {
+        char* index = data.data() + header.indexOffset + i * header.indexSize;
+        if (header.indexSize == 2)
+        {
+            quint16 value = quint16(indices[i]);
+            std::memcpy(index, &value, sizeof(value));
+        }
+        else
+        {
+            quint32 value = indices[i];
+            std::memcpy(index, &value, sizeof(value));
+        }
+    }
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    //  write atomically, several processes may share the cache
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.commit();
+}
@@ -0,0 +1,83 @@
+#ifndef MESHFILE_HPP
+#define MESHFILE_HPP
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+//  Compact binary triangle meshes, memory-mapped for loading.
+//
+//  A mesh file holds a header, the interleaved vertices and the indices,
+//  in the layout the GPU reads them, so that loading is mapping the file
+//  and uploading from the mapping. Positions keep full precision, since
+//  ssao and shadows compare depths, while normals are quantized to 10 bits
+//  and texture coordinates to half floats: 20 instead of 32 bytes per
+//  vertex. Indices take 16 bits when the vertices allow it.
+//  Files are written in the byte order of the machine; on others, the
+//  version does not match and opening fails.
+
+//  layout version; files of other versions are rejected
+#define MESH_FILE_VERSION 1
+
+struct MeshFileHeader
+{
+    char magic[8];                      // "SSAOMESH"
+    quint32 version;
+    quint32 vertexCount, indexCount;
+    quint32 indexSize;                  // bytes per index, 2 or 4
+    quint32 vertexOffset, indexOffset;  // from the start of the file
+    float min[3], max[3];               // bounds of the positions
+    float radius;                       // of the bounding sphere around the origin
+};
+
+struct MeshFileVertex
+{
+    float position[3];
+    quint32 normal;                     // signed normalized 2:10:10:10, w = 0
+    quint16 texCoord[2];                // half floats
+};
+
+//  a mesh file mapped into memory
+class MeshFile
+{
+private:
+    QFile _file;
+    uchar* _data;
+    const MeshFileHeader* _header;
+
+public:
+    MeshFile();
+    ~MeshFile();
+
+    //  map a file. fails if it is missing, truncated or of another version.
+    bool open(const QString& fileName);
+    void close();
+    bool isOpen() const { return _header != 0; }
+
+    const MeshFileHeader& header() const { return *_header; }
+    const MeshFileVertex* vertices() const;
+    const void* indices() const;
+};
+
+//  reorder a mesh for drawing: vertices with equal attributes are merged
+//  (OBJ loaders duplicate them per face corner), triangles are ordered for
+//  the post-transform vertex cache (Forsyth) and then, in clusters that
+//  keep that locality, from the outside in against overdraw (Sander et
+//  al.), and vertices are ordered by first use for fetch locality.
+//  positions have three floats per vertex, normals three or none and
+//  texture coordinates two or none.
+void optimizeMesh(QVector<float>& positions, QVector<float>& normals,
+    QVector<float>& texCoords, QVector<unsigned int>& indices);
+
+//  vertices transformed per triangle with a FIFO post-transform cache of
+//  cacheSize entries; between 0.5 (ideal) and 3
+float averageCacheMissRatio(const QVector<unsigned int>& indices, int cacheSize);
+
+//  write a mesh file, atomically and creating its directory. arrays as
+//  for optimizeMesh.
+bool writeMeshFile(const QString& fileName, const QVector<float>& positions,
+    const QVector<float>& normals, const QVector<float>& texCoords,
+    const QVector<unsigned int>& indices);
+
+#endif
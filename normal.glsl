@@ -0,0 +1,54 @@
+//  access to the view-space normals stored in the g-buffer (and in the
+//  normal levels of the reduced resolution ssao pyramid).
+//  with COMPACT_GBUFFER they are octahedral encoded into two unorm
+//  channels instead of three half floats.
+#ifdef COMPACT_GBUFFER
+//  fold the lower hemisphere of the octahedron over the upper one
+vec2 encode_normal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+vec3 decode_normal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#else
+vec3 encode_normal(vec3 n)
+{
+    return n;
+}
+
+vec3 decode_normal(vec3 n)
+{
+    return n;
+}
+#endif
+
+//  normal at texture coordinate uv
+vec3 gbuffer_normal(sampler2D normals, vec2 uv)
+{
+#ifdef COMPACT_GBUFFER
+    return decode_normal(texture(normals, uv).xy);
+#else
+    return texture(normals, uv).xyz;
+#endif
+}
+
+//  normal of a single texel
+vec3 gbuffer_normal_texel(sampler2D normals, ivec2 texel)
+{
+#ifdef COMPACT_GBUFFER
+    return decode_normal(texelFetch(normals, texel, 0).xy);
+#else
+    return texelFetch(normals, texel, 0).xyz;
+#endif
+}
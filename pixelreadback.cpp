@@ -0,0 +1,135 @@
+#include <cstring>
+
+#include "cgbase/cgtools.hpp"
+
+#include "pixelreadback.hpp"
+
+PixelReadback::PixelReadback() :
+    _initialized(false),
+    _width(0), _height(0),
+    _first(0), _count(0), _waits(0)
+{
+    for (int i = 0; i < SLOTS; i++)
+    {
+        this->_slots[i].colorBuffer = this->_slots[i].aoBuffer = 0;
+        this->_slots[i].fence = 0;
+    }
+}
+
+void PixelReadback::initialize(int width, int height)
+{
+    if (!this->_initialized)
+    {
+        this->initializeOpenGLFunctions();
+        this->_initialized = true;
+    }
+    this->destroy();
+    this->_width = width;
+    this->_height = height;
+
+    //  read by the CPU only, so preferably in client memory
+    GLsizeiptr size = GLsizeiptr(width) * height * 4;
+    for (int i = 0; i < SLOTS; i++)
+    {
+        Slot& slot = this->_slots[i];
+        glCreateBuffers(1, &slot.colorBuffer);
+        glNamedBufferStorage(slot.colorBuffer, size, NULL, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+        glCreateBuffers(1, &slot.aoBuffer);
+        glNamedBufferStorage(slot.aoBuffer, size, NULL, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+    }
+    CG_ASSERT_GLCHECK();
+}
+
+void PixelReadback::release()
+{
+    this->destroy();
+}
+
+void PixelReadback::destroy()
+{
+    for (int i = 0; i < SLOTS; i++)
+    {
+        Slot& slot = this->_slots[i];
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        if (slot.colorBuffer)
+        {
+            glDeleteBuffers(1, &slot.colorBuffer);
+            glDeleteBuffers(1, &slot.aoBuffer);
+        }
+        slot.colorBuffer = slot.aoBuffer = 0;
+        slot.fence = 0;
+    }
+    this->_first = this->_count = 0;
+}
+
+void PixelReadback::start(int index, GLuint framebuffer, GLuint aoTexture)
+{
+    Slot& slot = this->_slots[(this->_first + this->_count) % SLOTS];
+    GLsizei size = this->_width * this->_height * 4;
+
+    //  with a pack buffer bound, the pointers are offsets into it
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.colorBuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadPixels(0, 0, this->_width, this->_height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    slot.ao = (aoTexture != 0);
+    if (slot.ao)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.aoBuffer);
+        glGetTextureImage(aoTexture, 0, GL_RED, GL_FLOAT, size, NULL);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.index = index;
+    this->_count++;
+    CG_ASSERT_GLCHECK();
+}
+
+bool PixelReadback::finish(Frame& frame, bool wait)
+{
+    if (this->_count == 0)
+        return false;
+    Slot& slot = this->_slots[this->_first];
+
+    //  only flush when waiting; returns at once if the copy is done
+    GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        if (!wait)
+            return false;
+        this->_waits++;
+        do
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    //  copied out, so that the slot is free again and the frame can be
+    //  handed to other threads
+    GLsizeiptr size = GLsizeiptr(this->_width) * this->_height * 4;
+    frame.index = slot.index;
+    frame.width = this->_width;
+    frame.height = this->_height;
+    frame.color.resize(size);
+    const void* data = glMapNamedBufferRange(slot.colorBuffer, 0, size, GL_MAP_READ_BIT);
+    std::memcpy(frame.color.data(), data, size);
+    glUnmapNamedBuffer(slot.colorBuffer);
+    if (slot.ao)
+    {
+        frame.ao.resize(this->_width * this->_height);
+        data = glMapNamedBufferRange(slot.aoBuffer, 0, size, GL_MAP_READ_BIT);
+        std::memcpy(frame.ao.data(), data, size);
+        glUnmapNamedBuffer(slot.aoBuffer);
+    }
+    else
+    {
+        frame.ao.clear();
+    }
+    CG_ASSERT_GLCHECK();
+
+    this->_first = (this->_first + 1) % SLOTS;
+    this->_count--;
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef PIXELREADBACK_HPP
+#define PIXELREADBACK_HPP
+
+#include <QByteArray>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QVector>
+
+//  Asynchronous readback of rendered frames into client memory.
+//
+//  Reading pixels straight into client memory makes the driver wait until
+//  the GPU has finished the frame. Here every frame is read into its own
+//  pixel buffer objects instead, which only queues a copy; a fence tells
+//  when the copy is done, and the data is taken out of the buffers only
+//  then, usually a few frames later. The GPU can be SLOTS frames ahead
+//  before the CPU has to wait for it.
+//  All member functions expect the OpenGL context to be current.
+class PixelReadback : protected QOpenGLFunctions_4_5_Core
+{
+public:
+    enum { SLOTS = 3 };
+
+    //  a frame read back: the color as RGBA8 and the ao as floats, both
+    //  with the bottom row first, as OpenGL stores them. ao is empty if
+    //  the frame was read without it.
+    struct Frame
+    {
+        int index;
+        int width, height;
+        QByteArray color;
+        QVector<float> ao;
+    };
+
+private:
+    struct Slot
+    {
+        GLuint colorBuffer, aoBuffer;
+        GLsync fence;
+        int index;
+        bool ao;
+    };
+
+    bool _initialized;
+    int _width, _height;
+    Slot _slots[SLOTS];
+    int _first, _count;     // oldest pending slot, and pending slots
+    int _waits;
+
+    void destroy();
+
+public:
+    PixelReadback();
+
+    //  create the buffers for frames of the given size, and delete them
+    //  (pending frames are dropped)
+    void initialize(int width, int height);
+    void release();
+
+    //  whether finish() must free a slot before the next start()
+    bool isFull() const { return _count == SLOTS; }
+    bool isEmpty() const { return _count == 0; }
+
+    //  queue reading the first color attachment of framebuffer and, if
+    //  not 0, the red channel of aoTexture, both of the initialized size
+    void start(int index, GLuint framebuffer, GLuint aoTexture);
+
+    //  take the oldest pending frame. returns false if there is none, or
+    //  if its copy is not done yet and wait is false.
+    bool finish(Frame& frame, bool wait);
+
+    //  frames finish() had to wait for
+    int waits() const { return _waits; }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include <algorithm>
+
+#include "cgbase/cgtools.hpp"
+
+#include "rendertargetpool.hpp"
+
+bool RenderTargetPool::Format::operator==(const Format& other) const
+{
+    return width == other.width && height == other.height
+        && internalFormat == other.internalFormat
+        && levels == other.levels && filtering == other.filtering;
+}
+
+RenderTargetPool::RenderTargetPool() :
+    _initialized(false)
+{
+}
+
+bool RenderTargetPool::canAlias(const Target& target, const Texture& texture) const
+{
+    if (!(texture.format == target.format))
+        return false;
+    for (int i = 0; i < texture.targets.size(); i++)
+    {
+        const Target& other = this->_targets[texture.targets[i]];
+        if (target.firstUse <= other.lastUse && other.firstUse <= target.lastUse)
+            return false;
+    }
+    return true;
+}
+
+size_t RenderTargetPool::bytes(const Format& format)
+{
+    size_t texelBytes;
+    switch (format.internalFormat)
+    {
+    case GL_R8:
+        texelBytes = 1;
+        break;
+    case GL_R16F:
+        texelBytes = 2;
+        break;
+    case GL_R32F:
+    case GL_RG16:
+    case GL_RG16F:
+    case GL_RGBA8:
+    case GL_DEPTH_COMPONENT32F:
+        texelBytes = 4;
+        break;
+    case GL_RGB16F:     // usually padded to four components
+    case GL_RG32F:
+    case GL_RGBA16F:
+    case GL_DEPTH32F_STENCIL8:  // usually padded
+        texelBytes = 8;
+        break;
+    default:
+        texelBytes = 16;
+        break;
+    }
+
+    size_t result = 0;
+    int width = format.width, height = format.height;
+    for (int level = 0; level < format.levels; level++)
+    {
+        result += size_t(width) * height * texelBytes;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return result;
+}
+
+void RenderTargetPool::begin()
+{
+    this->_targets.clear();
+}
+
+int RenderTargetPool::declare(const Format& format, int firstUse, int lastUse)
+{
+    Target target;
+    target.format = format;
+    target.firstUse = firstUse;
+    target.lastUse = lastUse;
+    target.texture = -1;
+    this->_targets.append(target);
+    return this->_targets.size() - 1;
+}
+
+void RenderTargetPool::allocate()
+{
+    if (!this->_initialized)
+    {
+        this->initializeOpenGLFunctions();
+        this->_initialized = true;
+    }
+
+    //  first fit: the earliest texture (of the previous layout or newly
+    //  created) whose users all live at other times
+    for (int t = 0; t < this->_textures.size(); t++)
+        this->_textures[t].targets.clear();
+    for (int i = 0; i < this->_targets.size(); i++)
+    {
+        Target& target = this->_targets[i];
+        target.texture = -1;
+        for (int t = 0; t < this->_textures.size() && target.texture < 0; t++)
+            if (this->canAlias(target, this->_textures[t]))
+                target.texture = t;
+
+        if (target.texture < 0)
+        {
+            Texture texture;
+            texture.format = target.format;
+            glGenTextures(1, &texture.name);
+            glBindTexture(GL_TEXTURE_2D, texture.name);
+            glTexStorage2D(GL_TEXTURE_2D, target.format.levels, target.format.internalFormat,
+                target.format.width, target.format.height);
+            GLint minFilter = target.format.filtering;
+            if (target.format.levels > 1)
+                minFilter = (minFilter == GL_LINEAR) ? GL_LINEAR_MIPMAP_NEAREST : GL_NEAREST_MIPMAP_NEAREST;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, target.format.filtering);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, target.format.levels - 1);
+            CG_ASSERT_GLCHECK();
+            this->_textures.append(texture);
+            target.texture = this->_textures.size() - 1;
+        }
+        this->_textures[target.texture].targets.append(i);
+    }
+
+    //  delete textures nobody uses anymore, e.g. those of the old size
+    for (int t = this->_textures.size() - 1; t >= 0; t--)
+    {
+        if (!this->_textures[t].targets.isEmpty())
+            continue;
+        glDeleteTextures(1, &this->_textures[t].name);
+        this->_textures.remove(t);
+        for (int i = 0; i < this->_targets.size(); i++)
+            if (this->_targets[i].texture > t)
+                this->_targets[i].texture--;
+    }
+    CG_ASSERT_GLCHECK();
+}
+
+unsigned int RenderTargetPool::texture(int target) const
+{
+    if (target < 0 || target >= this->_targets.size() || this->_targets[target].texture < 0)
+        return 0;
+    return this->_textures[this->_targets[target].texture].name;
+}
+
+void RenderTargetPool::release()
+{
+    for (int t = 0; t < this->_textures.size(); t++)
+        glDeleteTextures(1, &this->_textures[t].name);
+    this->_textures.clear();
+    this->_targets.clear();
+}
+
+size_t RenderTargetPool::allocatedBytes() const
+{
+    size_t result = 0;
+    for (int t = 0; t < this->_textures.size(); t++)
+        result += bytes(this->_textures[t].format);
+    return result;
+}
+
+size_t RenderTargetPool::declaredBytes() const
+{
+    size_t result = 0;
+    for (int i = 0; i < this->_targets.size(); i++)
+        result += bytes(this->_targets[i].format);
+    return result;
+}
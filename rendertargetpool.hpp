@@ -0,0 +1,88 @@
+#ifndef RENDERTARGETPOOL_HPP
+#define RENDERTARGETPOOL_HPP
+
+#include <cstddef>
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QVector>
+
+//  Textures of the screen-size dependent render targets.
+//
+//  The renderer declares every target of its current layout together with
+//  its lifetime, i.e. the first and last step of a frame that uses it, and
+//  then calls allocate(). Targets with equal formats whose lifetimes do not
+//  overlap share one texture, and textures of the previous layout are kept
+//  where they still fit, so that a resize or a mode switch only creates
+//  what is missing and deletes what is no longer needed.
+//  All member functions expect the OpenGL context to be current.
+class RenderTargetPool : protected QOpenGLFunctions_4_5_Core
+{
+public:
+
+    //  immutable texture storage; only textures with equal formats alias
+    struct Format
+    {
+        int width, height;
+        GLenum internalFormat;  // sized internal format
+        int levels;             // mipmap levels
+        GLint filtering;        // GL_NEAREST or GL_LINEAR
+
+        bool operator==(const Format& other) const;
+    };
+
+private:
+
+    struct Texture
+    {
+        Format format;
+        unsigned int name;
+        QVector<int> targets;   // declared targets that use it
+    };
+
+    struct Target
+    {
+        Format format;
+        int firstUse, lastUse;
+        int texture;            // index into _textures
+    };
+
+    bool _initialized;
+    QVector<Texture> _textures;
+    QVector<Target> _targets;
+
+    //  whether target can share a texture with all of its current users
+    bool canAlias(const Target& target, const Texture& texture) const;
+
+    //  approximate video memory of one texture
+    static size_t bytes(const Format& format);
+
+public:
+    RenderTargetPool();
+
+    //  forget all declared targets, e.g. before declaring a new layout.
+    //  textures stay alive until the next allocate().
+    void begin();
+
+    //  declare a target used from step firstUse to lastUse (inclusive) of
+    //  every frame. targets that keep their content from one frame to the
+    //  next must extend their lifetime over all steps. returns the index
+    //  to query the texture with after allocate().
+    int declare(const Format& format, int firstUse, int lastUse);
+
+    //  assign a texture to every declared target
+    void allocate();
+
+    //  texture of a declared target
+    unsigned int texture(int target) const;
+
+    //  delete all textures
+    void release();
+
+    //  video memory of the allocated textures, and what it would be
+    //  with one texture per target
+    size_t allocatedBytes() const;
+    size_t declaredBytes() const;
+    int textureCount() const { return _textures.size(); }
+};
+
+#endif
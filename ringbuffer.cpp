@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "cgbase/cgtools.hpp"
+
+#include "ringbuffer.hpp"
+
+RingBuffer::RingBuffer() :
+    _initialized(false),
+    _buffer(0), _mapping(NULL), _regionSize(0), _alignment(1),
+    _region(0), _used(0), _waits(0)
+{
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+        this->_fences[i] = 0;
+}
+
+void RingBuffer::initialize(GLsizeiptr regionSize)
+{
+    if (!this->_initialized)
+    {
+        this->initializeOpenGLFunctions();
+        this->_initialized = true;
+    }
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->_alignment);
+    this->create(regionSize);
+}
+
+void RingBuffer::release()
+{
+    this->destroy();
+}
+
+void RingBuffer::wait(int region)
+{
+    GLsync fence = this->_fences[region];
+    if (!fence)
+        return;
+
+    //  only flush on the first try; returns at once if the GPU is done
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        this->_waits++;
+        do
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    this->_fences[region] = 0;
+}
+
+void RingBuffer::create(GLsizeiptr size)
+{
+    this->destroy();
+    this->_regionSize = this->alignedSize(size);
+
+    //  coherent, so that writes need no explicit flush
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &this->_buffer);
+    glNamedBufferStorage(this->_buffer, FRAMES_IN_FLIGHT * this->_regionSize, NULL, flags);
+    this->_mapping = static_cast<unsigned char*>(glMapNamedBufferRange(this->_buffer,
+        0, FRAMES_IN_FLIGHT * this->_regionSize, flags));
+    this->_region = 0;
+    this->_used = 0;
+    CG_ASSERT_GLCHECK();
+}
+
+void RingBuffer::destroy()
+{
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+        this->wait(i);
+    if (this->_buffer)
+    {
+        glUnmapNamedBuffer(this->_buffer);
+        glDeleteBuffers(1, &this->_buffer);
+    }
+    this->_buffer = 0;
+    this->_mapping = NULL;
+    this->_regionSize = 0;
+}
+
+void RingBuffer::beginFrame(GLsizeiptr size)
+{
+    //  a new buffer, since the GPU may still read any region of this one
+    if (size > this->_regionSize)
+    {
+        GLsizeiptr regionSize = std::max(this->_regionSize, GLsizeiptr(this->_alignment));
+        while (regionSize < size)
+            regionSize *= 2;
+        this->create(regionSize);
+    }
+    this->wait(this->_region);
+    this->_used = 0;
+}
+
+void RingBuffer::endFrame()
+{
+    this->_fences[this->_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->_region = (this->_region + 1) % FRAMES_IN_FLIGHT;
+}
+
+GLsizeiptr RingBuffer::alignedSize(GLsizeiptr size) const
+{
+    return (size + this->_alignment - 1) / this->_alignment * this->_alignment;
+}
+
+GLintptr RingBuffer::allocate(GLsizeiptr size)
+{
+    GLintptr offset = this->_region * this->_regionSize + this->_used;
+    this->_used += this->alignedSize(size);
+    return offset;
+}
@@ -0,0 +1,68 @@
+#ifndef RINGBUFFER_HPP
+#define RINGBUFFER_HPP
+
+#include <QOpenGLFunctions_4_5_Core>
+
+//  A persistently mapped buffer for the data the CPU writes every frame
+//  (the frame constants, the instance data).
+//
+//  The buffer is split into one region per frame in flight. A frame
+//  allocates from its region and writes through the mapping; a fence
+//  after the frame guards the region until the GPU has read it, so that
+//  the CPU only waits when it gets FRAMES_IN_FLIGHT frames ahead, and
+//  nothing is orphaned or copied by the driver. Allocations are aligned
+//  for uniform buffer ranges, so that they can be bound as uniform blocks
+//  as well as read as vertex data.
+//  All member functions expect the OpenGL context to be current.
+class RingBuffer : protected QOpenGLFunctions_4_5_Core
+{
+public:
+    enum { FRAMES_IN_FLIGHT = 3 };
+
+private:
+    bool _initialized;
+    GLuint _buffer;
+    unsigned char* _mapping;
+    GLsizeiptr _regionSize;
+    GLint _alignment;
+    int _region;                        // of the current frame
+    GLsizeiptr _used;                   // bytes of it allocated
+    GLsync _fences[FRAMES_IN_FLIGHT];   // 0 if the region is free
+    int _waits;
+
+    //  wait until the GPU is done with a region
+    void wait(int region);
+
+    //  (re)create the buffer with regions of at least size bytes
+    void create(GLsizeiptr size);
+    void destroy();
+
+public:
+    RingBuffer();
+
+    //  create the buffer, and delete it after waiting for the GPU
+    void initialize(GLsizeiptr regionSize);
+    void release();
+
+    //  start a frame allocating at most size bytes (sizes as returned by
+    //  alignedSize()), waiting for the GPU to finish reading its region.
+    //  the buffer grows if needed, after waiting for all regions.
+    void beginFrame(GLsizeiptr size);
+
+    //  fence the region of the frame
+    void endFrame();
+
+    //  bytes an allocation of size bytes takes
+    GLsizeiptr alignedSize(GLsizeiptr size) const;
+
+    //  size bytes of the current frame's region. returns the offset into
+    //  buffer(), whose contents are written at data(offset).
+    GLintptr allocate(GLsizeiptr size);
+    void* data(GLintptr offset) const { return _mapping + offset; }
+    GLuint buffer() const { return _buffer; }
+
+    //  frames that had to wait for the GPU to free their region
+    int waits() const { return _waits; }
+};
+
+#endif
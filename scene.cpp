@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include <QVector4D>
+
+#include "cgbase/cgtools.hpp"
+
+#include "scene.hpp"
+
+//  vertex buffer binding of the instance data in every mesh's vertex array
+#define INSTANCE_BINDING 8
+
+//  whether the box min..max is outside one of the planes
+static bool outside(const QVector4D planes[6], const QVector3D& min, const QVector3D& max)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        //  the corner farthest along the plane normal
+        const QVector4D& p = planes[i];
+        QVector3D corner(p.x() > 0.0f ? max.x() : min.x(),
+            p.y() > 0.0f ? max.y() : min.y(),
+            p.z() > 0.0f ? max.z() : min.z());
+        if (QVector3D::dotProduct(p.toVector3D(), corner) + p.w() < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+Scene::Scene() :
+    _initialized(false),
+    _staticVersion(0), _dynamicVersion(0),
+    _boundsValid(false),
+    _instanceBuffer(0), _instanceOffset(0)
+{
+    this->beginViews();
+}
+
+void Scene::initialize()
+{
+    if (!this->_initialized)
+    {
+        this->initializeOpenGLFunctions();
+        this->_initialized = true;
+    }
+}
+
+void Scene::release()
+{
+    this->_instanceBuffer = 0;
+    this->_instanceOffset = 0;
+    glDeleteVertexArrays(this->_meshVertexArrays.size(), this->_meshVertexArrays.constData());
+    glDeleteBuffers(this->_meshBuffers.size(), this->_meshBuffers.constData());
+    this->_meshVertexArrays.clear();
+    this->_meshBuffers.clear();
+    this->_meshes.clear();
+    this->clearInstances();
+    this->beginViews();
+}
+
+int Scene::addMesh(unsigned int vertexArray, int indexCount, const QVector<float>& positions)
+{
+    Mesh mesh;
+    mesh.vertexArray = vertexArray;
+    mesh.indexCount = indexCount;
+    mesh.indexType = GL_UNSIGNED_INT;
+    mesh.min = QVector3D(FLT_MAX, FLT_MAX, FLT_MAX);
+    mesh.max = QVector3D(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    mesh.radius = 0.0f;
+    for (int i = 0; i + 2 < positions.size(); i += 3)
+    {
+        QVector3D p(positions[i], positions[i + 1], positions[i + 2]);
+        for (int k = 0; k < 3; k++)
+        {
+            mesh.min[k] = std::min(mesh.min[k], p[k]);
+            mesh.max[k] = std::max(mesh.max[k], p[k]);
+        }
+        mesh.radius = std::max(mesh.radius, p.length());
+    }
+    return this->appendMesh(mesh);
+}
+
+int Scene::addMesh(const MeshFile& file)
+{
+    const MeshFileHeader& header = file.header();
+
+    //  immutable buffers, filled from the mapped file without a copy of
+    //  our own
+    GLuint buffers[2];
+    glCreateBuffers(2, buffers);
+    glNamedBufferStorage(buffers[0], header.vertexCount * sizeof(MeshFileVertex), file.vertices(), 0);
+    glNamedBufferStorage(buffers[1], header.indexCount * header.indexSize, file.indices(), 0);
+
+    //  the attribute locations of the vertex shaders: position, normal,
+    //  texture coordinates
+    GLuint vertexArray;
+    glCreateVertexArrays(1, &vertexArray);
+    glVertexArrayVertexBuffer(vertexArray, 0, buffers[0], 0, sizeof(MeshFileVertex));
+    glVertexArrayElementBuffer(vertexArray, buffers[1]);
+    glEnableVertexArrayAttrib(vertexArray, 0);
+    glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshFileVertex, position));
+    glVertexArrayAttribBinding(vertexArray, 0, 0);
+    glEnableVertexArrayAttrib(vertexArray, 1);
+    glVertexArrayAttribFormat(vertexArray, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(MeshFileVertex, normal));
+    glVertexArrayAttribBinding(vertexArray, 1, 0);
+    glEnableVertexArrayAttrib(vertexArray, 2);
+    glVertexArrayAttribFormat(vertexArray, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(MeshFileVertex, texCoord));
+    glVertexArrayAttribBinding(vertexArray, 2, 0);
+    CG_ASSERT_GLCHECK();
+    this->_meshBuffers.append(buffers[0]);
+    this->_meshBuffers.append(buffers[1]);
+    this->_meshVertexArrays.append(vertexArray);
+
+    Mesh mesh;
+    mesh.vertexArray = vertexArray;
+    mesh.indexCount = header.indexCount;
+    mesh.indexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mesh.min = QVector3D(header.min[0], header.min[1], header.min[2]);
+    mesh.max = QVector3D(header.max[0], header.max[1], header.max[2]);
+    mesh.radius = header.radius;
+    return this->appendMesh(mesh);
+}
+
+int Scene::appendMesh(const Mesh& mesh)
+{
+    this->_meshes.append(mesh);
+    this->_visible.resize(this->_meshes.size());
+
+    //  per-instance attributes: the columns of both matrices and the color,
+    //  at consecutive locations in the order of InstanceData
+    GLuint vertexArray = mesh.vertexArray;
+    glVertexArrayVertexBuffer(vertexArray, INSTANCE_BINDING, this->_instanceBuffer, this->_instanceOffset, sizeof(InstanceData));
+    glVertexArrayBindingDivisor(vertexArray, INSTANCE_BINDING, 1);
+    for (int i = 0; i < 9; i++)
+    {
+        GLuint location = ATTRIBUTE_MODEL_MATRIX + i;
+        glEnableVertexArrayAttrib(vertexArray, location);
+        glVertexArrayAttribFormat(vertexArray, location, 4, GL_FLOAT, GL_FALSE, i * 4 * sizeof(float));
+        glVertexArrayAttribBinding(vertexArray, location, INSTANCE_BINDING);
+    }
+    CG_ASSERT_GLCHECK();
+    return this->_meshes.size() - 1;
+}
+
+void Scene::clearInstances()
+{
+    this->_instances.clear();
+    this->_boundsValid = false;
+    this->_staticVersion++;
+    this->_dynamicVersion++;
+}
+
+int Scene::addInstance(int mesh, const QMatrix4x4& model, const QVector3D& color, bool dynamic)
+{
+    Instance instance;
+    instance.mesh = mesh;
+    instance.dynamic = dynamic;
+    instance.model = instance.previousModel = model;
+    instance.color = color;
+    this->updateBounds(instance);
+    this->_instances.append(instance);
+    this->_boundsValid = false;
+    if (dynamic)
+        this->_dynamicVersion++;
+    else
+        this->_staticVersion++;
+    return this->_instances.size() - 1;
+}
+
+void Scene::setModelMatrix(int instance, const QMatrix4x4& model)
+{
+    Instance& changed = this->_instances[instance];
+    if (model == changed.model)
+        return;
+    changed.model = model;
+    this->updateBounds(changed);
+    this->_boundsValid = false;
+    if (changed.dynamic)
+        this->_dynamicVersion++;
+    else
+        this->_staticVersion++;
+}
+
+void Scene::updateBounds(Instance& instance)
+{
+    const Mesh& mesh = this->_meshes[instance.mesh];
+    if (instance.dynamic)
+    {
+        //  the sphere around the origin, scaled by the largest axis
+        float scale = 0.0f;
+        for (int k = 0; k < 3; k++)
+            scale = std::max(scale, instance.model.column(k).toVector3D().length());
+        QVector3D center = instance.model.column(3).toVector3D();
+        QVector3D extent(mesh.radius * scale, mesh.radius * scale, mesh.radius * scale);
+        instance.min = center - extent;
+        instance.max = center + extent;
+        return;
+    }
+
+    //  the transformed corners of the mesh bounds
+    instance.min = QVector3D(FLT_MAX, FLT_MAX, FLT_MAX);
+    instance.max = QVector3D(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < 8; i++)
+    {
+        QVector3D corner((i & 1) ? mesh.max.x() : mesh.min.x(),
+            (i & 2) ? mesh.max.y() : mesh.min.y(),
+            (i & 4) ? mesh.max.z() : mesh.min.z());
+        corner = instance.model.map(corner);
+        for (int k = 0; k < 3; k++)
+        {
+            instance.min[k] = std::min(instance.min[k], corner[k]);
+            instance.max[k] = std::max(instance.max[k], corner[k]);
+        }
+    }
+}
+
+void Scene::updateHistory()
+{
+    for (int i = 0; i < this->_instances.size(); i++)
+        this->_instances[i].previousModel = this->_instances[i].model;
+}
+
+void Scene::bounds(QVector3D& min, QVector3D& max)
+{
+    if (!this->_boundsValid)
+    {
+        this->_boundsMin = QVector3D(FLT_MAX, FLT_MAX, FLT_MAX);
+        this->_boundsMax = QVector3D(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (int i = 0; i < this->_instances.size(); i++)
+            for (int k = 0; k < 3; k++)
+            {
+                this->_boundsMin[k] = std::min(this->_boundsMin[k], this->_instances[i].min[k]);
+                this->_boundsMax[k] = std::max(this->_boundsMax[k], this->_instances[i].max[k]);
+            }
+        this->_boundsValid = true;
+    }
+    min = this->_boundsMin;
+    max = this->_boundsMax;
+}
+
+void Scene::beginViews()
+{
+    this->_batches.clear();
+    this->_viewBatches.clear();
+    this->_viewBatches.append(0);
+    this->_data.clear();
+}
+
+int Scene::addView(const QMatrix4x4& PV, Filter filter)
+{
+    //  frustum planes, pointing inwards (Gribb and Hartmann)
+    QVector4D planes[6];
+    for (int i = 0; i < 3; i++)
+    {
+        planes[2 * i] = PV.row(3) + PV.row(i);
+        planes[2 * i + 1] = PV.row(3) - PV.row(i);
+    }
+
+    //  cull, and group the visible instances by mesh
+    for (int i = 0; i < this->_instances.size(); i++)
+    {
+        const Instance& instance = this->_instances[i];
+        if ((filter == StaticInstances && instance.dynamic) || (filter == DynamicInstances && !instance.dynamic))
+            continue;
+        if (!outside(planes, instance.min, instance.max))
+            this->_visible[instance.mesh].append(i);
+    }
+
+    //  one draw per mesh, reading its instances' data in sequence
+    for (int m = 0; m < this->_meshes.size(); m++)
+    {
+        QVector<int>& visible = this->_visible[m];
+        if (visible.isEmpty())
+            continue;
+        Batch batch;
+        batch.vertexArray = this->_meshes[m].vertexArray;
+        batch.indexCount = this->_meshes[m].indexCount;
+        batch.indexType = this->_meshes[m].indexType;
+        batch.firstInstance = this->_data.size();
+        batch.instanceCount = visible.size();
+        this->_batches.append(batch);
+
+        for (int i = 0; i < visible.size(); i++)
+        {
+            const Instance& instance = this->_instances[visible[i]];
+            InstanceData data;
+            std::memcpy(data.model, instance.model.constData(), sizeof(data.model));
+            std::memcpy(data.previousModel, instance.previousModel.constData(), sizeof(data.previousModel));
+            data.color[0] = instance.color.x();
+            data.color[1] = instance.color.y();
+            data.color[2] = instance.color.z();
+            data.color[3] = 1.0f;
+            this->_data.append(data);
+        }
+        visible.clear();
+    }
+    this->_viewBatches.append(this->_batches.size());
+    return this->_viewBatches.size() - 2;
+}
+
+//  never empty, since draws without instances (e.g. of the screen quad)
+//  still read the first one
+GLsizeiptr Scene::uploadSize(const RingBuffer& ring) const
+{
+    return ring.alignedSize(qMax(this->_data.size(), 1) * sizeof(InstanceData));
+}
+
+void Scene::upload(RingBuffer& ring)
+{
+    GLsizeiptr size = qMax(this->_data.size(), 1) * sizeof(InstanceData);
+    this->_instanceBuffer = ring.buffer();
+    this->_instanceOffset = ring.allocate(size);
+    if (!this->_data.isEmpty())
+        std::memcpy(ring.data(this->_instanceOffset), this->_data.constData(), this->_data.size() * sizeof(InstanceData));
+
+    //  the region, and the buffer when it grew, change every frame
+    for (int i = 0; i < this->_meshes.size(); i++)
+        glVertexArrayVertexBuffer(this->_meshes[i].vertexArray, INSTANCE_BINDING,
+            this->_instanceBuffer, this->_instanceOffset, sizeof(InstanceData));
+    CG_ASSERT_GLCHECK();
+}
+
+int Scene::visibleInstances(int view) const
+{
+    int count = 0;
+    for (int i = 0; i < this->batchCount(view); i++)
+        count += this->batch(view, i).instanceCount;
+    return count;
+}
@@ -0,0 +1,168 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QVector>
+#include <QVector3D>
+
+#include "meshfile.hpp"
+#include "ringbuffer.hpp"
+
+//  Meshes and their instances, drawn with one instanced draw per mesh.
+//
+//  Every instance has a model matrix (and the one of the previous frame,
+//  for motion vectors), a color, and is either static or dynamic. Each
+//  frame the renderer adds its views (the camera, the shadow cascades)
+//  with the instances they draw; addView() culls those against the view
+//  frustum and groups the visible ones by mesh, and upload() writes their
+//  data into the frame's region of the ring buffer, which the meshes read
+//  with an instance divisor. A view then takes one instanced draw per mesh with visible
+//  instances, so that the submission cost grows with the meshes, not with
+//  the instances.
+//  All member functions expect the OpenGL context to be current.
+class Scene : protected QOpenGLFunctions_4_5_Core
+{
+public:
+
+    //  the instances a view draws
+    enum Filter
+    {
+        AllInstances,
+        StaticInstances,
+        DynamicInstances
+    };
+
+    //  vertex attribute locations of the per-instance data, as declared
+    //  in the vertex shaders of the geometry and shadow passes
+    enum
+    {
+        ATTRIBUTE_MODEL_MATRIX = 4,         // mat4, four locations
+        ATTRIBUTE_PREV_MODEL_MATRIX = 8,    // mat4, four locations
+        ATTRIBUTE_COLOR = 12
+    };
+
+    //  one instanced draw of a view
+    struct Batch
+    {
+        unsigned int vertexArray;
+        int indexCount;
+        GLenum indexType;
+        int firstInstance, instanceCount;
+    };
+
+private:
+
+    struct Mesh
+    {
+        unsigned int vertexArray;
+        int indexCount;
+        GLenum indexType;
+        QVector3D min, max;     // object space bounds
+        float radius;           // of the bounding sphere around the origin
+    };
+
+    struct Instance
+    {
+        int mesh;
+        bool dynamic;
+        QMatrix4x4 model, previousModel;
+        QVector3D color;
+        QVector3D min, max;     // world space bounds
+    };
+
+    //  per-instance vertex data, as read by the shaders
+    struct InstanceData
+    {
+        float model[16];
+        float previousModel[16];
+        float color[4];
+    };
+
+    bool _initialized;
+    QVector<Mesh> _meshes;
+    QVector<Instance> _instances;
+    int _staticVersion, _dynamicVersion;
+
+    //  world bounds of all instances, recomputed when needed
+    bool _boundsValid;
+    QVector3D _boundsMin, _boundsMax;
+
+    //  views of the frame: their draws, and the data of their instances
+    //  in draw order
+    QVector<Batch> _batches;
+    QVector<int> _viewBatches;          // first batch of every view, plus the end
+    QVector<InstanceData> _data;
+    QVector<QVector<int> > _visible;    // scratch: visible instances per mesh
+
+    //  where upload() wrote the instance data
+    unsigned int _instanceBuffer;
+    GLintptr _instanceOffset;
+
+    //  objects of the meshes created from mesh files
+    QVector<unsigned int> _meshBuffers, _meshVertexArrays;
+
+    //  add a mesh, with the per-instance attributes added to its vertex array
+    int appendMesh(const Mesh& mesh);
+
+    //  world bounds of an instance. those of dynamic instances enclose
+    //  them in any rotation, so that rotating does not move the bounds.
+    void updateBounds(Instance& instance);
+
+public:
+    Scene();
+
+    //  initialize, and delete all instances and the objects of meshes
+    //  created from mesh files
+    void initialize();
+    void release();
+
+    //  a mesh drawn from vertexArray with indexCount indices; positions
+    //  (three floats per vertex) give its bounds. the per-instance
+    //  attributes are added to the vertex array.
+    int addMesh(unsigned int vertexArray, int indexCount, const QVector<float>& positions);
+
+    //  a mesh uploaded from a mapped mesh file, straight from the mapping;
+    //  the file may be closed afterwards
+    int addMesh(const MeshFile& file);
+
+    //  instances of the meshes. dynamic instances are the ones that move,
+    //  so that shadow maps of the static ones can be kept.
+    void clearInstances();
+    int addInstance(int mesh, const QMatrix4x4& model, const QVector3D& color, bool dynamic);
+    void setModelMatrix(int instance, const QMatrix4x4& model);
+    const QMatrix4x4& modelMatrix(int instance) const { return _instances[instance].model; }
+    int instanceCount() const { return _instances.size(); }
+
+    //  make the current model matrices the ones of the previous frame
+    void updateHistory();
+
+    //  world bounds of all instances
+    void bounds(QVector3D& min, QVector3D& max);
+
+    //  incremented whenever a static (dynamic) instance is added, removed
+    //  or moved
+    int staticVersion() const { return _staticVersion; }
+    int dynamicVersion() const { return _dynamicVersion; }
+
+    //  forget the views of the previous frame
+    void beginViews();
+
+    //  a view of the instances passing filter inside the frustum of PV.
+    //  returns the index to draw the view with after upload().
+    int addView(const QMatrix4x4& PV, Filter filter);
+
+    //  write the instance data of all views into the frame's ring buffer
+    //  region, taking uploadSize() bytes of it
+    GLsizeiptr uploadSize(const RingBuffer& ring) const;
+    void upload(RingBuffer& ring);
+
+    //  draws of a view, one per mesh with visible instances
+    int batchCount(int view) const { return _viewBatches[view + 1] - _viewBatches[view]; }
+    const Batch& batch(int view, int index) const { return _batches[_viewBatches[view] + index]; }
+
+    //  instances that passed the culling of a view
+    int visibleInstances(int view) const;
+};
+
+#endif
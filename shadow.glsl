@@ -0,0 +1,118 @@
+//  filtering of the shadow map (a layer per cascade).
+//  the plain pcf compares every texel of a PCF_SIZE x PCF_SIZE grid by
+//  hand. the other filters read the map through a depth-comparison
+//  sampler, so that every fetch returns the bilinearly weighted result of
+//  four compares:
+//  - SHADOW_FILTER_HARDWARE: a grid of fetches two texels apart, covering
+//    the same footprint with a quarter of the fetches
+//  - SHADOW_FILTER_OPTIMIZED: a tent filter of PCF_SIZE texels (1, 3, 5
+//    or 7) built from weighted bilinear fetches (Castaño's optimized pcf)
+//  - SHADOW_FILTER_POISSON: fetches on a disk of PCF_SIZE texels,
+//    rotated per pixel, trading banding for noise
+
+#if defined(SHADOW_FILTER_HARDWARE) || defined(SHADOW_FILTER_OPTIMIZED) || defined(SHADOW_FILTER_POISSON)
+#define SHADOW_COMPARE
+uniform sampler2DArrayShadow shadow_map;
+#else
+uniform sampler2DArray shadow_map;
+#endif
+
+//  width of the pcf kernel in texels (odd)
+#ifndef PCF_SIZE
+#define PCF_SIZE 3
+#endif
+
+//  fetches of the poisson disk, as many as the optimized pcf of that size
+#define POISSON_SAMPLES (((PCF_SIZE + 1) / 2) * ((PCF_SIZE + 1) / 2))
+
+#ifdef SHADOW_COMPARE
+//  lit fraction around uv, bilinearly weighted
+float shadow_compare(vec2 uv, int cascade, float depth)
+{
+    return texture(shadow_map, vec4(uv, float(cascade), depth));
+}
+#endif
+
+//  fraction of the kernel around S (shadow map coordinates and depth)
+//  that is in shadow
+float shadow_filter(vec3 S, int cascade, float bias)
+{
+    vec2 size = vec2(textureSize(shadow_map, 0).xy);
+    vec2 texelSize = 1.0 / size;
+    float depth = S.z - bias;
+
+#if defined(SHADOW_FILTER_HARDWARE)
+    //  bilinear fetches centered between texels, two texels apart
+    const int taps = (PCF_SIZE + 1) / 2;
+    float lit = 0.0;
+    for (int x = 0; x < taps; x++)
+        for (int y = 0; y < taps; y++)
+        {
+            vec2 offset = 2.0 * vec2(x, y) - float(taps - 1);
+            lit += shadow_compare(S.xy + offset * texelSize, cascade, depth);
+        }
+    return 1.0 - lit / float(taps * taps);
+
+#elif defined(SHADOW_FILTER_OPTIMIZED)
+    //  weights and offsets of the bilinear fetches along one axis, from
+    //  the position s within the texel
+    vec2 uv = S.xy * size;
+    vec2 base = floor(uv + 0.5);
+    vec2 s = uv + 0.5 - base;
+    base = (base - 0.5) * texelSize;
+#if PCF_SIZE == 1
+    return 1.0 - shadow_compare(S.xy, cascade, depth);
+#elif PCF_SIZE == 3
+    const int taps = 2;
+    const float total = 16.0;
+    vec2 w[2] = vec2[2](3.0 - 2.0 * s, 1.0 + 2.0 * s);
+    vec2 o[2] = vec2[2]((2.0 - s) / w[0] - 1.0, s / w[1] + 1.0);
+#elif PCF_SIZE == 5
+    const int taps = 3;
+    const float total = 144.0;
+    vec2 w[3] = vec2[3](4.0 - 3.0 * s, vec2(7.0), 1.0 + 3.0 * s);
+    vec2 o[3] = vec2[3]((3.0 - 2.0 * s) / w[0] - 2.0, (3.0 + s) / w[1], s / w[2] + 2.0);
+#else
+    const int taps = 4;
+    const float total = 2704.0;
+    vec2 w[4] = vec2[4](5.0 * s - 6.0, 11.0 * s - 28.0, -(11.0 * s + 17.0), -(5.0 * s + 1.0));
+    vec2 o[4] = vec2[4]((4.0 * s - 5.0) / w[0] - 3.0, (4.0 * s - 16.0) / w[1] - 1.0,
+        -(7.0 * s + 5.0) / w[2] + 1.0, -s / w[3] + 3.0);
+#endif
+#if PCF_SIZE > 1
+    float lit = 0.0;
+    for (int x = 0; x < taps; x++)
+        for (int y = 0; y < taps; y++)
+            lit += w[x].x * w[y].y
+                * shadow_compare(base + vec2(o[x].x, o[y].y) * texelSize, cascade, depth);
+    return 1.0 - lit / total;
+#endif
+
+#elif defined(SHADOW_FILTER_POISSON)
+    //  golden angle spiral, evenly covering the disk for any sample
+    //  count, rotated by interleaved gradient noise
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float radius = 0.5 * float(PCF_SIZE);
+    float lit = 0.0;
+    for (int i = 0; i < POISSON_SAMPLES; i++)
+    {
+        float r = radius * sqrt((float(i) + 0.5) / float(POISSON_SAMPLES));
+        float a = angle + 2.3999632 * float(i);
+        lit += shadow_compare(S.xy + r * vec2(cos(a), sin(a)) * texelSize, cascade, depth);
+    }
+    return 1.0 - lit / float(POISSON_SAMPLES);
+
+#else
+    //  manual compares of every texel of the grid
+    float shadow = 0.0;
+    for (int x = -PCF_SIZE / 2; x <= PCF_SIZE / 2; ++x)
+    {
+        for (int y = -PCF_SIZE / 2; y <= PCF_SIZE / 2; ++y)
+        {
+            float pcfDepth = texture(shadow_map, vec3(S.xy + vec2(x, y) * texelSize, cascade)).r;
+            shadow += depth > pcfDepth ? 1.0 : 0.0;
+        }
+    }
+    return shadow / float(PCF_SIZE * PCF_SIZE);
+#endif
+}
@@ -0,0 +1,460 @@
+//  Batch renderer: renders the frames of a camera and light script
+//  offscreen and writes the lit color and the ao of every frame as PNG or
+//  OpenEXR images, reporting the sustained frame rate as JSON.
+//
+//  Rendering, transfer and disk I/O overlap: frames are read back through
+//  a ring of pixel buffer objects (see PixelReadback), so that the GPU is
+//  never waited for while it is still rendering, and encoded and written
+//  by a pool of worker threads.
+//
+//  The script is a JSON object with an array of frames, e.g.
+//      { "frames": [ { "eye": [0, 0.7, 1.4], "center": [0, 0, 0],
+//                      "fov": 50, "light_azimuth": 0, "model_angle": 30 },
+//                    { "eye": [0.1, 0.7, 1.4] } ] }
+//  where a frame keeps every value it does not set from the previous one.
+//  The first frame starts from the default camera.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSurfaceFormat>
+#include <QThread>
+#include <QThreadPool>
+
+#include "pixelreadback.hpp"
+#include "ssaorenderer.hpp"
+
+//  camera and light of a frame of the script
+struct ScriptFrame
+{
+    QVector3D eye, center;
+    float fov;
+    int lightAzimuth;
+    float modelAngle;
+};
+
+//  set an environment variable only if the user did not set it already
+static void setDefaultEnv(const char* name, const char* value)
+{
+    if (!qEnvironmentVariableIsSet(name))
+        qputenv(name, value);
+}
+
+static QVector3D vector(const QJsonValue& value, const QVector3D& fallback)
+{
+    QJsonArray array = value.toArray();
+    if (array.size() != 3)
+        return fallback;
+    return QVector3D(array[0].toDouble(), array[1].toDouble(), array[2].toDouble());
+}
+
+//  read the frames of a script; returns false if it is not valid JSON or
+//  has no frames
+static bool readScript(const QString& fileName, QVector<ScriptFrame>& frames)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QJsonArray array = QJsonDocument::fromJson(file.readAll()).object()["frames"].toArray();
+
+    //  the default camera of SSAORenderer::defaultCamera
+    ScriptFrame frame;
+    frame.eye = QVector3D(0.0f, 0.7f, 1.4f);
+    frame.center = QVector3D();
+    frame.fov = 50.0f;
+    frame.lightAzimuth = 0;
+    frame.modelAngle = 0.0f;
+    for (int i = 0; i < array.size(); i++)
+    {
+        QJsonObject object = array[i].toObject();
+        frame.eye = vector(object["eye"], frame.eye);
+        frame.center = vector(object["center"], frame.center);
+        frame.fov = object["fov"].toDouble(frame.fov);
+        frame.lightAzimuth = object["light_azimuth"].toInt(frame.lightAzimuth);
+        frame.modelAngle = object["model_angle"].toDouble(frame.modelAngle);
+        frames.append(frame);
+    }
+    return !frames.isEmpty();
+}
+
+//  the parts of an OpenEXR file, in its byte order (little-endian, as
+//  are the machines we render on)
+static void append(QByteArray& data, const void* bytes, int size)
+{
+    data.append(static_cast<const char*>(bytes), size);
+}
+
+static void appendString(QByteArray& data, const char* string)
+{
+    append(data, string, int(std::strlen(string)) + 1);
+}
+
+static void appendInt(QByteArray& data, qint32 value)
+{
+    append(data, &value, sizeof(value));
+}
+
+static void appendAttribute(QByteArray& data, const char* name, const char* type, int size)
+{
+    appendString(data, name);
+    appendString(data, type);
+    appendInt(data, size);
+}
+
+//  write an uncompressed scanline OpenEXR file of 32 bit float channels.
+//  pixels are interleaved with the channels in the order of names, which
+//  must be sorted as OpenEXR requires; rows are bottom first, as read
+//  back from OpenGL.
+static bool writeEXR(const QString& fileName, int width, int height,
+    int channels, const char* const* names, const float* pixels)
+{
+    //  magic number and version 2, single part scanline file
+    QByteArray data;
+    const unsigned char magic[4] = { 0x76, 0x2f, 0x31, 0x01 };
+    append(data, magic, 4);
+    appendInt(data, 2);
+
+    int channelListSize = 1;
+    for (int c = 0; c < channels; c++)
+        channelListSize += int(std::strlen(names[c])) + 1 + 16;
+    appendAttribute(data, "channels", "chlist", channelListSize);
+    for (int c = 0; c < channels; c++)
+    {
+        const char linear[4] = { 0, 0, 0, 0 };
+        appendString(data, names[c]);
+        appendInt(data, 2);             // FLOAT
+        append(data, linear, 4);        // pLinear and reserved
+        appendInt(data, 1);             // x and y sampling
+        appendInt(data, 1);
+    }
+    append(data, "", 1);
+    appendAttribute(data, "compression", "compression", 1);
+    append(data, "", 1);                // NO_COMPRESSION
+    qint32 window[4] = { 0, 0, width - 1, height - 1 };
+    appendAttribute(data, "dataWindow", "box2i", 16);
+    append(data, window, 16);
+    appendAttribute(data, "displayWindow", "box2i", 16);
+    append(data, window, 16);
+    appendAttribute(data, "lineOrder", "lineOrder", 1);
+    append(data, "", 1);                // INCREASING_Y
+    const float one = 1.0f, center[2] = { 0.0f, 0.0f };
+    appendAttribute(data, "pixelAspectRatio", "float", 4);
+    append(data, &one, 4);
+    appendAttribute(data, "screenWindowCenter", "v2f", 8);
+    append(data, center, 8);
+    appendAttribute(data, "screenWindowWidth", "float", 4);
+    append(data, &one, 4);
+    append(data, "", 1);
+
+    //  offset table, then one chunk per line: y, size, and the line of
+    //  each channel in turn
+    qint32 lineSize = width * channels * 4;
+    quint64 offset = data.size() + quint64(height) * 8;
+    for (int y = 0; y < height; y++)
+    {
+        append(data, &offset, 8);
+        offset += 8 + lineSize;
+    }
+    QVector<float> line(width);
+    for (int y = 0; y < height; y++)
+    {
+        appendInt(data, y);
+        appendInt(data, lineSize);
+        const float* row = pixels + size_t(height - 1 - y) * width * channels;
+        for (int c = 0; c < channels; c++)
+        {
+            for (int x = 0; x < width; x++)
+                line[x] = row[x * channels + c];
+            append(data, line.constData(), width * 4);
+        }
+    }
+
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+}
+
+//  encodes and writes the images of a frame, on a worker thread
+class WriteTask : public QRunnable
+{
+private:
+    PixelReadback::Frame _frame;
+    QString _colorFile, _aoFile;
+    bool _exr;
+    QSemaphore& _queue;
+    QAtomicInt& _failures;
+
+public:
+    WriteTask(const PixelReadback::Frame& frame, const QString& colorFile, const QString& aoFile,
+        bool exr, QSemaphore& queue, QAtomicInt& failures) :
+        _frame(frame), _colorFile(colorFile), _aoFile(aoFile), _exr(exr),
+        _queue(queue), _failures(failures)
+    {
+    }
+
+    void run() override
+    {
+        if (!this->writeColor() || (!this->_frame.ao.isEmpty() && !this->writeAO()))
+            this->_failures.ref();
+        this->_queue.release();
+    }
+
+private:
+    bool writeColor()
+    {
+        const PixelReadback::Frame& frame = this->_frame;
+        const uchar* rgba = reinterpret_cast<const uchar*>(frame.color.constData());
+        if (!this->_exr)
+        {
+            QImage image(rgba, frame.width, frame.height, frame.width * 4, QImage::Format_RGBA8888);
+            return image.mirrored().convertToFormat(QImage::Format_RGB888).save(this->_colorFile, "PNG");
+        }
+        //  the display values, as the lit image is not kept in high range
+        static const char* const names[3] = { "B", "G", "R" };
+        QVector<float> pixels(frame.width * frame.height * 3);
+        for (int i = 0; i < frame.width * frame.height; i++)
+            for (int c = 0; c < 3; c++)
+                pixels[i * 3 + c] = rgba[i * 4 + 2 - c] / 255.0f;
+        return ::writeEXR(this->_colorFile, frame.width, frame.height, 3, names, pixels.constData());
+    }
+
+    bool writeAO()
+    {
+        const PixelReadback::Frame& frame = this->_frame;
+        if (!this->_exr)
+        {
+            QImage image(frame.width, frame.height, QImage::Format_Grayscale8);
+            for (int y = 0; y < frame.height; y++)
+            {
+                const float* row = frame.ao.constData() + (frame.height - 1 - y) * frame.width;
+                uchar* line = image.scanLine(y);
+                for (int x = 0; x < frame.width; x++)
+                    line[x] = uchar(std::min(std::max(row[x], 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+            return image.save(this->_aoFile, "PNG");
+        }
+        static const char* const names[1] = { "Y" };
+        return ::writeEXR(this->_aoFile, frame.width, frame.height, 1, names, frame.ao.constData());
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    //  headless EGL context through Mesa's surfaceless platform
+    setDefaultEnv("QT_QPA_PLATFORM", "eglfs");
+    setDefaultEnv("QT_QPA_EGLFS_INTEGRATION", "none");
+    setDefaultEnv("EGL_PLATFORM", "surfaceless");
+
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render the frames of a camera and light script to color and AO images.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("script", "JSON camera and light script.");
+    QCommandLineOption directoryOption("output-dir", "Directory of the images.", "directory", ".");
+    QCommandLineOption formatOption("format", "Image format: png or exr.", "format", "png");
+    QCommandLineOption noAOOutputOption("no-ao-output", "Only write the lit color, not the AO.");
+    QCommandLineOption threadsOption("threads", "Encoding threads (default: one per core, less one for rendering).", "n");
+    QCommandLineOption widthOption("width", "Framebuffer width.", "pixels", "1920");
+    QCommandLineOption heightOption("height", "Framebuffer height.", "pixels", "1080");
+    QCommandLineOption outputOption("output", "Write JSON to this file instead of stdout.", "file");
+    QCommandLineOption qualityOption("quality", "Quality tier: low, medium, high or ultra.", "tier", "high");
+    QCommandLineOption techniqueOption("ao-technique", "AO technique: hemisphere, hbao or gtao.", "technique", "hemisphere");
+    QCommandLineOption objectsOption("objects", "Number of models in the scene, in a grid on the plane.", "n", "1");
+    parser.addOption(directoryOption);
+    parser.addOption(formatOption);
+    parser.addOption(noAOOutputOption);
+    parser.addOption(threadsOption);
+    parser.addOption(widthOption);
+    parser.addOption(heightOption);
+    parser.addOption(outputOption);
+    parser.addOption(qualityOption);
+    parser.addOption(techniqueOption);
+    parser.addOption(objectsOption);
+    parser.process(app);
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    int width = std::max(parser.value(widthOption).toInt(), 1);
+    int height = std::max(parser.value(heightOption).toInt(), 1);
+    int threads = parser.isSet(threadsOption) ? parser.value(threadsOption).toInt()
+        : QThread::idealThreadCount() - 1;
+    threads = std::max(threads, 1);
+    QDir directory(parser.value(directoryOption));
+    QString format = parser.value(formatOption);
+    if (format != "png" && format != "exr")
+    {
+        std::fprintf(stderr, "unknown image format %s\n", qPrintable(format));
+        return 1;
+    }
+
+    int quality = 0;
+    while (quality < SSAORenderer::QualityCount
+        && parser.value(qualityOption) != SSAORenderer::qualityName(quality))
+        quality++;
+    if (quality == SSAORenderer::QualityCount)
+    {
+        std::fprintf(stderr, "unknown quality tier %s\n", qPrintable(parser.value(qualityOption)));
+        return 1;
+    }
+
+    int technique = 0;
+    while (technique < SSAORenderer::AOTechniqueCount
+        && parser.value(techniqueOption) != SSAORenderer::aoTechniqueName(technique))
+        technique++;
+    if (technique == SSAORenderer::AOTechniqueCount)
+    {
+        std::fprintf(stderr, "unknown AO technique %s\n", qPrintable(parser.value(techniqueOption)));
+        return 1;
+    }
+
+    QVector<ScriptFrame> script;
+    QString scriptFile = parser.positionalArguments()[0];
+    if (!readScript(scriptFile, script))
+    {
+        std::fprintf(stderr, "cannot read frames from %s\n", qPrintable(scriptFile));
+        return 1;
+    }
+    if (!directory.mkpath("."))
+    {
+        std::fprintf(stderr, "cannot create %s\n", qPrintable(directory.path()));
+        return 1;
+    }
+
+    //  create the context, same version as the interactive application
+    QSurfaceFormat surfaceFormat;
+    surfaceFormat.setProfile(QSurfaceFormat::CoreProfile);
+    surfaceFormat.setVersion(4, 5);
+
+    QOpenGLContext context;
+    context.setFormat(surfaceFormat);
+    if (!context.create())
+    {
+        std::fprintf(stderr, "cannot create OpenGL %d.%d context\n",
+            surfaceFormat.majorVersion(), surfaceFormat.minorVersion());
+        return 1;
+    }
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!context.makeCurrent(&surface))
+    {
+        std::fprintf(stderr, "cannot make OpenGL context current\n");
+        return 1;
+    }
+
+    QOpenGLFramebufferObject target(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    SSAORenderer renderer;
+    renderer.setQuality(SSAORenderer::Quality(quality));
+    renderer.setAOTechnique(SSAORenderer::AOTechnique(technique));
+    renderer.setSceneObjects(parser.value(objectsOption).toInt());
+    renderer.setAnimated(false);
+    renderer.initialize(width, height);
+
+    PixelReadback readback;
+    readback.initialize(width, height);
+    bool writeAO = !parser.isSet(noAOOutputOption);
+
+    //  frames waiting for a worker are bounded, so that a slow disk makes
+    //  the rendering wait instead of filling the memory
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QSemaphore queue(2 * threads);
+    QAtomicInt failures(0);
+    int queueWaits = 0;
+
+    //  the timer includes writing the last image, for the sustained rate
+    QElapsedTimer timer;
+    timer.start();
+    PixelReadback::Frame frame;
+    frame.index = -1;
+    for (int i = 0; i <= script.size(); i++)
+    {
+        if (i < script.size())
+        {
+            const ScriptFrame& s = script[i];
+            QMatrix4x4 P, V;
+            P.perspective(s.fov, float(width) / float(height), 0.05f, 10.0f);
+            V.lookAt(s.eye, s.center, QVector3D(0.0f, 1.0f, 0.0f));
+            renderer.setLightAzimuthAngle(s.lightAzimuth);
+            renderer.setModelAngle(s.modelAngle);
+            renderer.render(P, V, width, height, 0.0f, target.handle());
+            if (readback.isFull())
+                readback.finish(frame, true);
+        }
+
+        //  hand on all frames that are ready; at the end, all of them
+        bool last = (i == script.size());
+        while (frame.index >= 0 || readback.finish(frame, last))
+        {
+            QString name = directory.filePath(QString("%1_%2.") + format);
+            if (!queue.tryAcquire())
+            {
+                queueWaits++;
+                queue.acquire();
+            }
+            pool.start(new WriteTask(frame,
+                name.arg("color").arg(frame.index, 5, 10, QChar('0')),
+                name.arg("ao").arg(frame.index, 5, 10, QChar('0')),
+                format == "exr", queue, failures));
+            frame.index = -1;
+        }
+
+        if (!last)
+            readback.start(i, target.handle(), writeAO ? renderer.aoTexture() : 0);
+    }
+    pool.waitForDone();
+    double seconds = timer.nsecsElapsed() * 1e-9;
+    readback.release();
+
+    QJsonObject result;
+    result["renderer"] = QString(reinterpret_cast<const char*>(
+        context.functions()->glGetString(GL_RENDERER)));
+    result["script"] = scriptFile;
+    result["width"] = width;
+    result["height"] = height;
+    result["frames"] = script.size();
+    result["format"] = format;
+    result["ao_output"] = writeAO && renderer.isAOEnabled();
+    result["threads"] = threads;
+    result["seconds"] = seconds;
+    result["frames_per_second"] = script.size() / seconds;
+    result["readback_waits"] = readback.waits();
+    result["queue_waits"] = queueWaits;
+    result["failed_frames"] = failures.load();
+
+    QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    }
+    else
+    {
+        std::fputs(json.constData(), stdout);
+    }
+    return failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,386 @@
+//  Headless benchmark: renders a number of frames offscreen and reports
+//  per-pass GPU timings (min/median/p99) as JSON.
+//
+//  By default an EGL surfaceless context is used, so this runs without any
+//  display server (e.g. on Mesa llvmpipe). Set QT_QPA_PLATFORM yourself to
+//  override this, e.g. QT_QPA_PLATFORM=xcb on a desktop machine.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+#include "ssaorenderer.hpp"
+
+//  GL_ARB_pipeline_statistics_query, core since OpenGL 4.6
+#ifndef GL_VERTEX_SHADER_INVOCATIONS
+#define GL_VERTEX_SHADER_INVOCATIONS 0x82F0
+#endif
+
+//  set an environment variable only if the user did not set it already
+static void setDefaultEnv(const char* name, const char* value)
+{
+    if (!qEnvironmentVariableIsSet(name))
+        qputenv(name, value);
+}
+
+//  value at the given percentile of sorted samples (nearest rank)
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+}
+
+static QJsonObject statistics(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    QJsonObject stats;
+    stats["min_ms"] = samples.empty() ? 0.0 : samples.front();
+    stats["median_ms"] = percentile(samples, 50.0);
+    stats["p99_ms"] = percentile(samples, 99.0);
+    stats["samples"] = static_cast<int>(samples.size());
+    return stats;
+}
+
+int main(int argc, char* argv[])
+{
+    //  headless EGL context through Mesa's surfaceless platform
+    setDefaultEnv("QT_QPA_PLATFORM", "eglfs");
+    setDefaultEnv("QT_QPA_EGLFS_INTEGRATION", "none");
+    setDefaultEnv("EGL_PLATFORM", "surfaceless");
+
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Offscreen SSAO benchmark with per-pass GPU timings.");
+    parser.addHelpOption();
+    QCommandLineOption framesOption("frames", "Number of measured frames.", "n", "200");
+    QCommandLineOption warmupOption("warmup", "Number of frames rendered before measuring.", "n", "10");
+    QCommandLineOption widthOption("width", "Framebuffer width.", "pixels", "1920");
+    QCommandLineOption heightOption("height", "Framebuffer height.", "pixels", "1080");
+    QCommandLineOption outputOption("output", "Write JSON to this file instead of stdout.", "file");
+    QCommandLineOption reconstructOption("reconstruct", "Reconstruct positions from depth instead of a position g-buffer.");
+    QCommandLineOption compactOption("compact-gbuffer", "Octahedral normals, R8 AO targets and no shadow coordinate target.");
+    QCommandLineOption aoDivisorOption("ao-resolution", "SSAO resolution divisor: 1 (full), 2 (half) or 4 (quarter).", "divisor", "1");
+    QCommandLineOption qualityOption("quality", "Quality tier: low, medium, high or ultra.", "tier", "high");
+    QCommandLineOption blurRadiusOption("blur-radius", "SSAO blur radius in texels per direction (overrides the tier).", "texels");
+    QCommandLineOption temporalOption("temporal", "Accumulate SSAO over frames with reprojection.");
+    QCommandLineOption temporalSamplesOption("temporal-samples", "SSAO samples per frame in temporal mode.", "n", "16");
+    QCommandLineOption techniqueOption("ao-technique", "AO technique: hemisphere, hbao or gtao.", "technique", "hemisphere");
+    QCommandLineOption radiusOption("ao-radius", "SSAO kernel radius in view-space units.", "radius", "0.5");
+    QCommandLineOption noAOOption("no-ao", "Light without ambient occlusion (culls the AO passes).");
+    QCommandLineOption noShadowsOption("no-shadows", "Light without shadows (culls the shadow pass).");
+    QCommandLineOption cascadesOption("shadow-cascades", "Number of shadow map cascades (1 to 4).", "n", "1");
+    QCommandLineOption shadowSizeOption("shadow-map-size", "Shadow map resolution per cascade.", "texels", "1024");
+    QCommandLineOption shadowFilterOption("shadow-filter", "Shadow map filter: pcf, hardware, optimized or poisson.", "filter", "optimized");
+    QCommandLineOption lightsOption("lights", "Number of point and spot lights besides the sun.", "n", "0");
+    QCommandLineOption lightCullingOption("light-culling", "Light culling: tiled or naive.", "culling", "tiled");
+    QCommandLineOption objectsOption("objects", "Number of models in the scene, in a grid on the plane.", "n", "1");
+    QCommandLineOption adaptiveOption("adaptive-ao", "Skip the background in SSAO and adapt the hemisphere taps per pixel.");
+    QCommandLineOption hizOption("hiz", "Sample distant SSAO taps from a min/max depth pyramid.");
+    QCommandLineOption cacheOption("program-cache", "Directory of the program binary cache.", "directory");
+    QCommandLineOption noCacheOption("no-program-cache", "Always compile shaders from source.");
+    QCommandLineOption meshCacheOption("mesh-cache", "Directory of the converted mesh cache.", "directory");
+    QCommandLineOption noMeshCacheOption("no-mesh-cache", "Always parse the model from OBJ, without optimizing it.");
+    QCommandLineOption pathOption("ao-path", "SSAO implementation: fragment or compute.", "path", "fragment");
+    parser.addOption(framesOption);
+    parser.addOption(warmupOption);
+    parser.addOption(widthOption);
+    parser.addOption(heightOption);
+    parser.addOption(outputOption);
+    parser.addOption(reconstructOption);
+    parser.addOption(compactOption);
+    parser.addOption(aoDivisorOption);
+    parser.addOption(qualityOption);
+    parser.addOption(blurRadiusOption);
+    parser.addOption(temporalOption);
+    parser.addOption(temporalSamplesOption);
+    parser.addOption(techniqueOption);
+    parser.addOption(radiusOption);
+    parser.addOption(hizOption);
+    parser.addOption(adaptiveOption);
+    parser.addOption(noAOOption);
+    parser.addOption(noShadowsOption);
+    parser.addOption(cascadesOption);
+    parser.addOption(shadowSizeOption);
+    parser.addOption(shadowFilterOption);
+    parser.addOption(lightsOption);
+    parser.addOption(lightCullingOption);
+    parser.addOption(objectsOption);
+    parser.addOption(pathOption);
+    parser.addOption(cacheOption);
+    parser.addOption(noCacheOption);
+    parser.addOption(meshCacheOption);
+    parser.addOption(noMeshCacheOption);
+    parser.process(app);
+
+    int frames = std::max(parser.value(framesOption).toInt(), 1);
+    int warmup = std::max(parser.value(warmupOption).toInt(), 0);
+    int width = std::max(parser.value(widthOption).toInt(), 1);
+    int height = std::max(parser.value(heightOption).toInt(), 1);
+
+    int quality = 0;
+    while (quality < SSAORenderer::QualityCount
+        && parser.value(qualityOption) != SSAORenderer::qualityName(quality))
+        quality++;
+    if (quality == SSAORenderer::QualityCount)
+    {
+        std::fprintf(stderr, "unknown quality tier %s\n", qPrintable(parser.value(qualityOption)));
+        return 1;
+    }
+
+    int technique = 0;
+    while (technique < SSAORenderer::AOTechniqueCount
+        && parser.value(techniqueOption) != SSAORenderer::aoTechniqueName(technique))
+        technique++;
+    if (technique == SSAORenderer::AOTechniqueCount)
+    {
+        std::fprintf(stderr, "unknown AO technique %s\n", qPrintable(parser.value(techniqueOption)));
+        return 1;
+    }
+
+    int shadowFilter = 0;
+    while (shadowFilter < SSAORenderer::ShadowFilterCount
+        && parser.value(shadowFilterOption) != SSAORenderer::shadowFilterName(shadowFilter))
+        shadowFilter++;
+    if (shadowFilter == SSAORenderer::ShadowFilterCount)
+    {
+        std::fprintf(stderr, "unknown shadow filter %s\n", qPrintable(parser.value(shadowFilterOption)));
+        return 1;
+    }
+
+    int lightCulling = 0;
+    while (lightCulling < SSAORenderer::LightCullingCount
+        && parser.value(lightCullingOption) != SSAORenderer::lightCullingName(lightCulling))
+        lightCulling++;
+    if (lightCulling == SSAORenderer::LightCullingCount)
+    {
+        std::fprintf(stderr, "unknown light culling %s\n", qPrintable(parser.value(lightCullingOption)));
+        return 1;
+    }
+
+    //  create the context, same version as the interactive application
+    QSurfaceFormat format;
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setVersion(4, 5);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create())
+    {
+        std::fprintf(stderr, "cannot create OpenGL %d.%d context\n",
+            format.majorVersion(), format.minorVersion());
+        return 1;
+    }
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!context.makeCurrent(&surface))
+    {
+        std::fprintf(stderr, "cannot make OpenGL context current\n");
+        return 1;
+    }
+
+    //  final color goes into an FBO instead of a window
+    QOpenGLFramebufferObject target(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    SSAORenderer renderer;
+    renderer.setReconstructPosition(parser.isSet(reconstructOption));
+    renderer.setCompactGBuffer(parser.isSet(compactOption));
+    renderer.setAODivisor(parser.value(aoDivisorOption).toInt());
+    renderer.setQuality(SSAORenderer::Quality(quality));
+    if (parser.isSet(blurRadiusOption))
+        renderer.setBlurRadius(parser.value(blurRadiusOption).toInt());
+    renderer.setTemporal(parser.isSet(temporalOption));
+    renderer.setTemporalSamples(parser.value(temporalSamplesOption).toInt());
+    renderer.setAOTechnique(SSAORenderer::AOTechnique(technique));
+    renderer.setAORadius(parser.value(radiusOption).toFloat());
+    renderer.setHiZ(parser.isSet(hizOption));
+    renderer.setAdaptiveAO(parser.isSet(adaptiveOption));
+    renderer.setComputeSSAO(parser.value(pathOption) == "compute");
+    renderer.setAOEnabled(!parser.isSet(noAOOption));
+    renderer.setShadowsEnabled(!parser.isSet(noShadowsOption));
+    renderer.setShadowCascades(parser.value(cascadesOption).toInt());
+    renderer.setShadowMapSize(parser.value(shadowSizeOption).toInt());
+    renderer.setShadowFilter(SSAORenderer::ShadowFilter(shadowFilter));
+    renderer.setLocalLights(parser.value(lightsOption).toInt());
+    renderer.setLightCulling(SSAORenderer::LightCulling(lightCulling));
+    renderer.setSceneObjects(parser.value(objectsOption).toInt());
+    if (parser.isSet(noCacheOption))
+        SSAORenderer::setProgramCacheDirectory(QString());
+    else if (parser.isSet(cacheOption))
+        SSAORenderer::setProgramCacheDirectory(parser.value(cacheOption));
+    if (parser.isSet(noMeshCacheOption))
+        SSAORenderer::setMeshCacheDirectory(QString());
+    else if (parser.isSet(meshCacheOption))
+        SSAORenderer::setMeshCacheDirectory(parser.value(meshCacheOption));
+
+    //  startup cost: initialization is dominated by building programs, and
+    //  some drivers only finish compiling when a program is first used
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    renderer.initialize(width, height);
+    double initializeMs = startupTimer.nsecsElapsed() * 1e-6;
+    renderer.setTimingEnabled(true);
+
+    QMatrix4x4 P, V;
+    SSAORenderer::defaultCamera(width, height, P, V);
+
+    //  fixed time step, so that every run renders the same frames
+    const float deltaTime = 1.0f / 60.0f;
+    std::vector<double> samples[SSAORenderer::PassCount];
+    std::vector<double> totals;
+    double aoSamples = 0.0;
+    int aoSampleFrames = 0;
+    int overflowTiles = -1;
+
+    //  one extra frame, because timings are read back one frame late
+    double firstFrameMs = 0.0;
+    int shadowSkipped = 0;
+    for (int frame = 0; frame < warmup + frames + 1; frame++)
+    {
+        renderer.render(P, V, width, height, deltaTime, target.handle());
+        if (frame == 0)
+        {
+            context.functions()->glFinish();
+            firstFrameMs = startupTimer.nsecsElapsed() * 1e-6 - initializeMs;
+        }
+        if (frame > warmup && renderer.shadowPassSkipped())
+            shadowSkipped++;
+
+        double ms[SSAORenderer::PassCount];
+        if (frame <= warmup || !renderer.passTimes(ms))
+            continue;
+        //  passes that did not run are left out, not counted as zero
+        double total = 0.0;
+        for (int i = 0; i < SSAORenderer::PassCount; i++)
+        {
+            if (ms[i] < 0.0)
+                continue;
+            samples[i].push_back(ms[i]);
+            total += ms[i];
+        }
+        totals.push_back(total);
+        if (renderer.meanAOSamples() >= 0.0f)
+        {
+            aoSamples += renderer.meanAOSamples();
+            aoSampleFrames++;
+        }
+        overflowTiles = std::max(overflowTiles, renderer.lightOverflowTiles());
+    }
+
+    //  vertex shader invocations of one more frame (all passes), where the
+    //  driver counts them; post-transform cache hits are not counted
+    qint64 vertexInvocations = -1;
+    if (context.hasExtension("GL_ARB_pipeline_statistics_query")
+        || context.format().majorVersion() * 10 + context.format().minorVersion() >= 46)
+    {
+        QOpenGLExtraFunctions* gl = context.extraFunctions();
+        GLuint query;
+        gl->glGenQueries(1, &query);
+        gl->glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, query);
+        renderer.render(P, V, width, height, deltaTime, target.handle());
+        gl->glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+        GLuint invocations = 0;
+        gl->glGetQueryObjectuiv(query, GL_QUERY_RESULT, &invocations);
+        gl->glDeleteQueries(1, &query);
+        vertexInvocations = invocations;
+    }
+
+    QJsonObject passes;
+    for (int i = 0; i < SSAORenderer::PassCount; i++)
+        passes[SSAORenderer::passName(i)] = statistics(samples[i]);
+
+    //  passes the frame graph kept, in execution order
+    QJsonArray scheduled;
+    for (int i = 0; i < renderer.scheduledPassCount(); i++)
+        scheduled.append(QString(renderer.scheduledPassName(i)));
+
+    QJsonObject result;
+    result["renderer"] = QString(reinterpret_cast<const char*>(
+        context.functions()->glGetString(GL_RENDERER)));
+    result["width"] = width;
+    result["height"] = height;
+    result["frames"] = frames;
+    result["warmup"] = warmup;
+    result["program_cache"] = !SSAORenderer::programCacheDirectory().isEmpty();
+    result["initialize_ms"] = initializeMs;
+    result["render_target_mb"] = renderer.renderTargetBytes() / 1048576.0;
+    result["render_target_unaliased_mb"] = renderer.unaliasedRenderTargetBytes() / 1048576.0;
+    result["first_frame_ms"] = firstFrameMs;
+    result["reconstruct_position"] = renderer.reconstructPosition();
+    result["compact_gbuffer"] = renderer.compactGBuffer();
+    result["ao_divisor"] = renderer.aoDivisor();
+    result["quality"] = SSAORenderer::qualityName(renderer.quality());
+    result["blur_radius"] = renderer.blurRadius();
+    result["pcf_size"] = renderer.pcfSize();
+    result["ao_technique"] = SSAORenderer::aoTechniqueName(renderer.aoTechnique());
+    result["ao_radius"] = renderer.aoRadius();
+    result["hiz"] = renderer.hiZ();
+    result["adaptive_ao"] = renderer.isAdaptiveAO();
+    if (aoSampleFrames > 0)
+        result["ao_mean_samples"] = aoSamples / aoSampleFrames;
+    result["ao_path"] = renderer.computeSSAO() ? "compute" : "fragment";
+    result["temporal"] = renderer.isTemporal();
+    if (renderer.isTemporal())
+        result["temporal_samples"] = renderer.temporalSamples();
+    result["ao"] = renderer.isAOEnabled();
+    result["shadows"] = renderer.areShadowsEnabled();
+    result["shadow_cascades"] = renderer.shadowCascades();
+    result["shadow_map_size"] = renderer.shadowMapSize();
+    result["shadow_filter"] = SSAORenderer::shadowFilterName(renderer.shadowFilter());
+    result["shadow_fetches"] = SSAORenderer::shadowFetches(renderer.shadowFilter(), renderer.pcfSize());
+    result["local_lights"] = renderer.localLights();
+    result["light_culling"] = SSAORenderer::lightCullingName(renderer.lightCulling());
+    if (overflowTiles >= 0)
+        result["light_overflow_tiles"] = overflowTiles;
+    result["scheduled_passes"] = scheduled;
+    result["shadow_skipped_frames"] = shadowSkipped;
+    result["scene_objects"] = renderer.sceneObjects();
+    result["visible_instances"] = renderer.visibleInstances();
+    result["draw_calls"] = renderer.drawCalls();
+    result["mesh_cache"] = !SSAORenderer::meshCacheDirectory().isEmpty();
+    result["mesh_cache_hit"] = renderer.meshCacheHit();
+    result["mesh_load_ms"] = renderer.meshLoadTime();
+    if (vertexInvocations >= 0)
+        result["vertex_shader_invocations"] = double(vertexInvocations);
+    result["state_changes"] = renderer.stateChanges();
+    result["state_changes_skipped"] = renderer.skippedStateChanges();
+    result["ring_waits"] = renderer.ringWaits();
+    result["passes"] = passes;
+    result["total"] = statistics(totals);
+
+    QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    }
+    else
+    {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+    }
+
+    return 0;
+}
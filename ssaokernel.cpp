@@ -0,0 +1,54 @@
+#include <cmath>
+#include <random>
+
+#include "ssaokernel.hpp"
+
+//  inline function to perform linear interpolation
+static inline float lerp(float a, float b, float f) { return a + f * (b - a); }
+
+void generateSSAOKernel(float kernel[SSAO_KERNEL_SIZE * 3],
+    float noise[SSAO_NOISE_SIZE * SSAO_NOISE_SIZE * 3])
+{
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // generates random floats between 0.0 and 1.0
+    std::default_random_engine generator;
+
+    // generate sample kernel
+    // ----------------------
+    for (int i = 0; i < SSAO_KERNEL_SIZE; ++i)
+    {
+        float x = randomFloats(generator) * 2.0f - 1.0f;
+        float y = randomFloats(generator) * 2.0f - 1.0f;
+        float z = randomFloats(generator);
+
+        //  normalize (in double precision, like QVector3D), then scatter
+        //  inside the hemisphere
+        double length = std::sqrt(double(x) * x + double(y) * y + double(z) * z);
+        if (length > 0.0)
+        {
+            x = float(x / length);
+            y = float(y / length);
+            z = float(z / length);
+        }
+        float r = randomFloats(generator);
+        x *= r;
+        y *= r;
+        z *= r;
+
+        // scale samples s.t. they're more aligned to center of kernel
+        float scale = float(i) / SSAO_KERNEL_SIZE;
+        scale = lerp(0.1f, 1.0f, scale * scale);
+
+        kernel[i * 3 + 0] = x * scale;
+        kernel[i * 3 + 1] = y * scale;
+        kernel[i * 3 + 2] = z * scale;
+    }
+
+    // generate noise texture
+    // ----------------------
+    for (int i = 0; i < SSAO_NOISE_SIZE * SSAO_NOISE_SIZE; i++)
+    {
+        noise[i * 3 + 0] = randomFloats(generator) * 2.0f - 1.0f;
+        noise[i * 3 + 1] = randomFloats(generator) * 2.0f - 1.0f;
+        noise[i * 3 + 2] = 0.0f; // rotate around z-axis (in tangent space)
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef SSAOKERNEL_HPP
+#define SSAOKERNEL_HPP
+
+//  number of hemisphere kernel samples and width of the square noise tile
+#define SSAO_KERNEL_SIZE 64
+#define SSAO_NOISE_SIZE 4
+
+//  generate the hemisphere sample kernel (xyz per sample, in tangent space,
+//  denser towards the center) and the noise vectors (xyz per texel, rotations
+//  around the normal) of the ssao pass.
+//  the random engine is seeded the same way every time, so the GPU renderer
+//  and the CPU reference implementation get identical samples.
+void generateSSAOKernel(float kernel[SSAO_KERNEL_SIZE * 3],
+    float noise[SSAO_NOISE_SIZE * SSAO_NOISE_SIZE * 3]);
+
+#endif
@@ -0,0 +1,680 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+#include "ssaoreference.hpp"
+
+//  the SIMD kernels need GCC/Clang function attributes, so that the rest
+//  of the code still builds for the baseline instruction set
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SSAO_REFERENCE_X86 1
+#include <immintrin.h>
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+//  square tiles of the ssao pass; a multiple of 8 pixels wide, so that the
+//  AVX2 loop only needs a scalar tail at the right image border
+#define TILE_SIZE 32
+
+//  rows per band of the rasterizer
+#define BAND_HEIGHT 16
+
+//  run body(0..count-1) on up to threadCount threads. items are handed out
+//  one at a time, so uneven items (e.g. background tiles) balance out.
+static void parallelFor(int count, int threadCount, const std::function<void(int)>& body)
+{
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++)
+            body(i);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < std::min(threadCount, count); i++)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+void SoftwareGBuffer::resize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    size_t n = size_t(width) * height;
+    x.assign(n, 0.0f);
+    y.assign(n, 0.0f);
+    z.assign(n, 0.0f);
+    nx.assign(n, 0.0f);
+    ny.assign(n, 0.0f);
+    nz.assign(n, 0.0f);
+    depth.assign(n, 1.0f);
+}
+
+SSAOReference::SIMDLevel SSAOReference::supportedSIMDLevel()
+{
+#ifdef SSAO_REFERENCE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SIMD_SSE41;
+#endif
+    return SIMD_Scalar;
+}
+
+const char* SSAOReference::simdLevelName(int level)
+{
+    switch (level)
+    {
+    case SIMD_Scalar:
+        return "scalar";
+    case SIMD_SSE41:
+        return "sse4.1";
+    case SIMD_AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+SSAOReference::SSAOReference() :
+    _threadCount(std::max(int(std::thread::hardware_concurrency()), 1)),
+    _simdLevel(supportedSIMDLevel()),
+    _radius(0.5f),
+    _bias(0.025f),
+    _blurRadius(2),
+    _blurDepthSharpness(32.0f),
+    _blurNormalPower(8.0f)
+{
+    ::generateSSAOKernel(this->_kernel, this->_noise);
+}
+
+void SSAOReference::setThreadCount(int count)
+{
+    this->_threadCount = std::max(count, 1);
+}
+
+void SSAOReference::setSIMDLevel(SIMDLevel level)
+{
+    //  never use more than the CPU supports
+    this->_simdLevel = std::min(level, supportedSIMDLevel());
+}
+
+/* Rasterization */
+
+//  vertex after the vertex shader: clip position plus varyings
+struct ClipVertex
+{
+    float clip[4];
+    float position[3];
+    float normal[3];
+};
+
+static ClipVertex lerpVertex(const ClipVertex& a, const ClipVertex& b, float t)
+{
+    ClipVertex v;
+    for (int i = 0; i < 4; i++)
+        v.clip[i] = a.clip[i] + t * (b.clip[i] - a.clip[i]);
+    for (int i = 0; i < 3; i++)
+    {
+        v.position[i] = a.position[i] + t * (b.position[i] - a.position[i]);
+        v.normal[i] = a.normal[i] + t * (b.normal[i] - a.normal[i]);
+    }
+    return v;
+}
+
+//  triangle in window coordinates, ready for scan conversion. varyings are
+//  divided by w, so that they interpolate linearly in screen space.
+struct ScreenTriangle
+{
+    float sx[3], sy[3];     // window position
+    float depth[3];         // window depth
+    float invW[3];
+    float position[3][3];   // position / w
+    float normal[3][3];     // normal / w
+    int minX, maxX, minY, maxY;
+};
+
+//  top-left fill rule for counter-clockwise triangles with y up: pixels
+//  exactly on an edge belong to the triangle only for left and top edges
+static bool isTopLeft(float ex, float ey)
+{
+    return ey < 0.0f || (ey == 0.0f && ex < 0.0f);
+}
+
+static void setupTriangle(const ClipVertex v[3], int width, int height,
+    std::vector<ScreenTriangle>& triangles)
+{
+    ScreenTriangle t;
+    for (int i = 0; i < 3; i++)
+    {
+        float invW = 1.0f / v[i].clip[3];
+        t.sx[i] = (v[i].clip[0] * invW * 0.5f + 0.5f) * width;
+        t.sy[i] = (v[i].clip[1] * invW * 0.5f + 0.5f) * height;
+        t.depth[i] = v[i].clip[2] * invW * 0.5f + 0.5f;
+        t.invW[i] = invW;
+        for (int j = 0; j < 3; j++)
+        {
+            t.position[i][j] = v[i].position[j] * invW;
+            t.normal[i][j] = v[i].normal[j] * invW;
+        }
+    }
+
+    //  back face culling (counter-clockwise is front, as in GL)
+    float area = (t.sx[1] - t.sx[0]) * (t.sy[2] - t.sy[0])
+        - (t.sx[2] - t.sx[0]) * (t.sy[1] - t.sy[0]);
+    if (!(area > 0.0f))
+        return;
+
+    t.minX = std::max(int(std::floor(std::min(std::min(t.sx[0], t.sx[1]), t.sx[2]))), 0);
+    t.maxX = std::min(int(std::ceil(std::max(std::max(t.sx[0], t.sx[1]), t.sx[2]))), width - 1);
+    t.minY = std::max(int(std::floor(std::min(std::min(t.sy[0], t.sy[1]), t.sy[2]))), 0);
+    t.maxY = std::min(int(std::ceil(std::max(std::max(t.sy[0], t.sy[1]), t.sy[2]))), height - 1);
+    if (t.minX <= t.maxX && t.minY <= t.maxY)
+        triangles.push_back(t);
+}
+
+//  scan convert the part of a triangle that lies in rows [y0, y1)
+static void rasterizeTriangle(SoftwareGBuffer& g, const ScreenTriangle& t, int y0, int y1)
+{
+    int minY = std::max(t.minY, y0);
+    int maxY = std::min(t.maxY, y1 - 1);
+
+    float area = (t.sx[1] - t.sx[0]) * (t.sy[2] - t.sy[0])
+        - (t.sx[2] - t.sx[0]) * (t.sy[1] - t.sy[0]);
+    float invArea = 1.0f / area;
+
+    //  edge i is opposite of vertex i
+    float ex[3], ey[3];
+    bool topLeft[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        ex[i] = t.sx[b] - t.sx[a];
+        ey[i] = t.sy[b] - t.sy[a];
+        topLeft[i] = isTopLeft(ex[i], ey[i]);
+    }
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        float py = y + 0.5f;
+        for (int x = t.minX; x <= t.maxX; x++)
+        {
+            float px = x + 0.5f;
+            float w[3];
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+            {
+                int a = (i + 1) % 3;
+                w[i] = ex[i] * (py - t.sy[a]) - ey[i] * (px - t.sx[a]);
+                if (w[i] < 0.0f || (w[i] == 0.0f && !topLeft[i]))
+                    inside = false;
+            }
+            if (!inside)
+                continue;
+            float b0 = w[0] * invArea, b1 = w[1] * invArea, b2 = w[2] * invArea;
+
+            //  depth test (GL_LESS)
+            size_t index = size_t(y) * g.width + x;
+            float depth = b0 * t.depth[0] + b1 * t.depth[1] + b2 * t.depth[2];
+            if (!(depth < g.depth[index]) || depth < 0.0f)
+                continue;
+            g.depth[index] = depth;
+
+            //  perspective correct varyings
+            float invW = 1.0f / (b0 * t.invW[0] + b1 * t.invW[1] + b2 * t.invW[2]);
+            float v[2][3];
+            for (int j = 0; j < 3; j++)
+            {
+                v[0][j] = (b0 * t.position[0][j] + b1 * t.position[1][j] + b2 * t.position[2][j]) * invW;
+                v[1][j] = (b0 * t.normal[0][j] + b1 * t.normal[1][j] + b2 * t.normal[2][j]) * invW;
+            }
+            float length = std::sqrt(v[1][0] * v[1][0] + v[1][1] * v[1][1] + v[1][2] * v[1][2]);
+            float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+            g.x[index] = v[0][0];
+            g.y[index] = v[0][1];
+            g.z[index] = v[0][2];
+            g.nx[index] = v[1][0] * invLength;
+            g.ny[index] = v[1][1] * invLength;
+            g.nz[index] = v[1][2] * invLength;
+        }
+    }
+}
+
+void SSAOReference::rasterize(SoftwareGBuffer& gBuffer,
+    const float* positions, const float* normals,
+    const unsigned int* indices, int indexCount,
+    const float modelview[16], const float normalMatrix[9],
+    const float projection[16]) const
+{
+    //  vertex processing and near plane clipping (the only plane that is
+    //  needed; the bounding box takes care of the others)
+    std::vector<ScreenTriangle> triangles;
+    for (int i = 0; i + 2 < indexCount; i += 3)
+    {
+        ClipVertex in[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const float* p = positions + 3 * indices[i + k];
+            const float* n = normals + 3 * indices[i + k];
+            ClipVertex& v = in[k];
+            for (int j = 0; j < 3; j++)
+            {
+                v.position[j] = modelview[j] * p[0] + modelview[4 + j] * p[1] + modelview[8 + j] * p[2] + modelview[12 + j];
+                v.normal[j] = normalMatrix[j] * n[0] + normalMatrix[3 + j] * n[1] + normalMatrix[6 + j] * n[2];
+            }
+            for (int j = 0; j < 4; j++)
+                v.clip[j] = projection[j] * v.position[0] + projection[4 + j] * v.position[1]
+                    + projection[8 + j] * v.position[2] + projection[12 + j];
+        }
+
+        //  Sutherland-Hodgman against z >= -w
+        ClipVertex out[4];
+        int outCount = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const ClipVertex& a = in[k];
+            const ClipVertex& b = in[(k + 1) % 3];
+            float da = a.clip[2] + a.clip[3];
+            float db = b.clip[2] + b.clip[3];
+            if (da >= 0.0f)
+                out[outCount++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                out[outCount++] = lerpVertex(a, b, da / (da - db));
+        }
+        for (int k = 1; k + 1 < outCount; k++)
+        {
+            ClipVertex fan[3] = { out[0], out[k], out[k + 1] };
+            setupTriangle(fan, gBuffer.width, gBuffer.height, triangles);
+        }
+    }
+
+    //  bands of rows are independent, so threads need no synchronization
+    int bands = (gBuffer.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    parallelFor(bands, this->_threadCount, [&](int band) {
+        int y0 = band * BAND_HEIGHT;
+        int y1 = std::min(y0 + BAND_HEIGHT, gBuffer.height);
+        for (size_t i = 0; i < triangles.size(); i++)
+            if (triangles[i].minY < y1 && triangles[i].maxY >= y0)
+                rasterizeTriangle(gBuffer, triangles[i], y0, y1);
+    });
+}
+
+/* Ambient occlusion */
+
+//  everything the ao kernels read
+struct AOContext
+{
+    int width, height;
+    const float *x, *y, *z, *nx, *ny, *nz;
+    const float* kernel;
+    const float* projection;
+    float radius, bias;
+
+    //  normalized noise vectors per noise row, repeated so that 8 columns
+    //  starting at any x can be loaded at once
+    float noiseX[SSAO_NOISE_SIZE][SSAO_NOISE_SIZE + 8];
+    float noiseY[SSAO_NOISE_SIZE][SSAO_NOISE_SIZE + 8];
+};
+
+//  one pixel; the SIMD kernels below do exactly the same per lane, with
+//  the same operations in the same order, so results are bit-identical.
+//  no fused multiply-add is used, for the same reason.
+static float aoPixel(const AOContext& c, int x, int y)
+{
+    size_t index = size_t(y) * c.width + x;
+    float px = c.x[index], py = c.y[index], pz = c.z[index];
+    if (pz == 0.0f)
+        return 1.0f;
+
+    float nx = c.nx[index], ny = c.ny[index], nz = c.nz[index];
+    float inv = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz);
+    nx *= inv;
+    ny *= inv;
+    nz *= inv;
+
+    float rx = c.noiseX[y % SSAO_NOISE_SIZE][x % SSAO_NOISE_SIZE];
+    float ry = c.noiseY[y % SSAO_NOISE_SIZE][x % SSAO_NOISE_SIZE];
+
+    //  Gram-Schmidt: tangent and bitangent
+    float d = rx * nx + ry * ny;
+    float tx = rx - nx * d, ty = ry - ny * d, tz = 0.0f - nz * d;
+    inv = 1.0f / std::sqrt(tx * tx + ty * ty + tz * tz);
+    tx *= inv;
+    ty *= inv;
+    tz *= inv;
+    float bx = ny * tz - nz * ty;
+    float by = nz * tx - nx * tz;
+    float bz = nx * ty - ny * tx;
+
+    const float* P = c.projection;
+    float occlusion = 0.0f;
+    for (int k = 0; k < SSAO_KERNEL_SIZE; k++)
+    {
+        float kx = c.kernel[3 * k], ky = c.kernel[3 * k + 1], kz = c.kernel[3 * k + 2];
+        float sx = px + (tx * kx + bx * ky + nx * kz) * c.radius;
+        float sy = py + (ty * kx + by * ky + ny * kz) * c.radius;
+        float sz = pz + (tz * kx + bz * ky + nz * kz) * c.radius;
+
+        float cx = P[0] * sx + P[4] * sy + P[8] * sz + P[12];
+        float cy = P[1] * sx + P[5] * sy + P[9] * sz + P[13];
+        float cw = P[3] * sx + P[7] * sy + P[11] * sz + P[15];
+        float u = (cx / cw) * 0.5f + 0.5f;
+        float v = (cy / cw) * 0.5f + 0.5f;
+
+        //  nearest texel, clamped to the edge
+        float fx = std::floor(u * c.width), fy = std::floor(v * c.height);
+        fx = fx > 0.0f ? fx : 0.0f;
+        fy = fy > 0.0f ? fy : 0.0f;
+        fx = std::min(fx, float(c.width - 1));
+        fy = std::min(fy, float(c.height - 1));
+        float sampleDepth = c.z[int(fy) * c.width + int(fx)];
+
+        float range = c.radius / std::fabs(pz - sampleDepth);
+        range = std::min(range > 0.0f ? range : 0.0f, 1.0f);
+        range = range * range * (3.0f - 2.0f * range);
+        if (sampleDepth >= sz + c.bias)
+            occlusion += range;
+    }
+    return 1.0f - occlusion / SSAO_KERNEL_SIZE;
+}
+
+static void aoSpanScalar(const AOContext& c, int y, int x0, int x1, float* ao)
+{
+    for (int x = x0; x < x1; x++)
+        ao[size_t(y) * c.width + x] = aoPixel(c, x, y);
+}
+
+#ifdef SSAO_REFERENCE_X86
+
+TARGET_SSE41 static void aoSpanSSE41(const AOContext& c, int y, int x0, int x1, float* ao)
+{
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f), three = _mm_set1_ps(3.0f), two = _mm_set1_ps(2.0f);
+    const __m128 width = _mm_set1_ps(float(c.width)), height = _mm_set1_ps(float(c.height));
+    const __m128 maxX = _mm_set1_ps(float(c.width - 1)), maxY = _mm_set1_ps(float(c.height - 1));
+    const __m128 radius = _mm_set1_ps(c.radius), bias = _mm_set1_ps(c.bias);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 count = _mm_set1_ps(float(SSAO_KERNEL_SIZE));
+    const float* P = c.projection;
+
+    int x = x0;
+    for (; x + 4 <= x1; x += 4)
+    {
+        size_t index = size_t(y) * c.width + x;
+        __m128 px = _mm_loadu_ps(c.x + index);
+        __m128 py = _mm_loadu_ps(c.y + index);
+        __m128 pz = _mm_loadu_ps(c.z + index);
+        __m128 nx = _mm_loadu_ps(c.nx + index);
+        __m128 ny = _mm_loadu_ps(c.ny + index);
+        __m128 nz = _mm_loadu_ps(c.nz + index);
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz))));
+        nx = _mm_mul_ps(nx, inv);
+        ny = _mm_mul_ps(ny, inv);
+        nz = _mm_mul_ps(nz, inv);
+
+        __m128 rx = _mm_loadu_ps(c.noiseX[y % SSAO_NOISE_SIZE] + x % SSAO_NOISE_SIZE);
+        __m128 ry = _mm_loadu_ps(c.noiseY[y % SSAO_NOISE_SIZE] + x % SSAO_NOISE_SIZE);
+
+        __m128 d = _mm_add_ps(_mm_mul_ps(rx, nx), _mm_mul_ps(ry, ny));
+        __m128 tx = _mm_sub_ps(rx, _mm_mul_ps(nx, d));
+        __m128 ty = _mm_sub_ps(ry, _mm_mul_ps(ny, d));
+        __m128 tz = _mm_sub_ps(zero, _mm_mul_ps(nz, d));
+        inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz))));
+        tx = _mm_mul_ps(tx, inv);
+        ty = _mm_mul_ps(ty, inv);
+        tz = _mm_mul_ps(tz, inv);
+        __m128 bx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+        __m128 by = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+        __m128 bz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+
+        __m128 occlusion = zero;
+        for (int k = 0; k < SSAO_KERNEL_SIZE; k++)
+        {
+            __m128 kx = _mm_set1_ps(c.kernel[3 * k]);
+            __m128 ky = _mm_set1_ps(c.kernel[3 * k + 1]);
+            __m128 kz = _mm_set1_ps(c.kernel[3 * k + 2]);
+            __m128 sx = _mm_add_ps(px, _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(tx, kx), _mm_mul_ps(bx, ky)), _mm_mul_ps(nx, kz)), radius));
+            __m128 sy = _mm_add_ps(py, _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(ty, kx), _mm_mul_ps(by, ky)), _mm_mul_ps(ny, kz)), radius));
+            __m128 sz = _mm_add_ps(pz, _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(tz, kx), _mm_mul_ps(bz, ky)), _mm_mul_ps(nz, kz)), radius));
+
+            __m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(P[0]), sx),
+                _mm_mul_ps(_mm_set1_ps(P[4]), sy)), _mm_mul_ps(_mm_set1_ps(P[8]), sz)), _mm_set1_ps(P[12]));
+            __m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(P[1]), sx),
+                _mm_mul_ps(_mm_set1_ps(P[5]), sy)), _mm_mul_ps(_mm_set1_ps(P[9]), sz)), _mm_set1_ps(P[13]));
+            __m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(P[3]), sx),
+                _mm_mul_ps(_mm_set1_ps(P[7]), sy)), _mm_mul_ps(_mm_set1_ps(P[11]), sz)), _mm_set1_ps(P[15]));
+            __m128 u = _mm_add_ps(_mm_mul_ps(_mm_div_ps(cx, cw), half), half);
+            __m128 v = _mm_add_ps(_mm_mul_ps(_mm_div_ps(cy, cw), half), half);
+
+            //  max with zero as second operand also maps NaN to zero
+            __m128 fx = _mm_min_ps(_mm_max_ps(_mm_floor_ps(_mm_mul_ps(u, width)), zero), maxX);
+            __m128 fy = _mm_min_ps(_mm_max_ps(_mm_floor_ps(_mm_mul_ps(v, height)), zero), maxY);
+            __m128i texel = _mm_add_epi32(_mm_mullo_epi32(_mm_cvttps_epi32(fy),
+                _mm_set1_epi32(c.width)), _mm_cvttps_epi32(fx));
+            __m128 sampleDepth = _mm_setr_ps(
+                c.z[_mm_extract_epi32(texel, 0)], c.z[_mm_extract_epi32(texel, 1)],
+                c.z[_mm_extract_epi32(texel, 2)], c.z[_mm_extract_epi32(texel, 3)]);
+
+            __m128 range = _mm_div_ps(radius, _mm_andnot_ps(signMask, _mm_sub_ps(pz, sampleDepth)));
+            range = _mm_min_ps(_mm_max_ps(range, zero), one);
+            range = _mm_mul_ps(_mm_mul_ps(range, range), _mm_sub_ps(three, _mm_mul_ps(two, range)));
+            __m128 mask = _mm_cmpge_ps(sampleDepth, _mm_add_ps(sz, bias));
+            occlusion = _mm_add_ps(occlusion, _mm_and_ps(mask, range));
+        }
+        __m128 result = _mm_sub_ps(one, _mm_div_ps(occlusion, count));
+        result = _mm_blendv_ps(result, one, _mm_cmpeq_ps(pz, zero));
+        _mm_storeu_ps(ao + index, result);
+    }
+    aoSpanScalar(c, y, x, x1, ao);
+}
+
+TARGET_AVX2 static void aoSpanAVX2(const AOContext& c, int y, int x0, int x1, float* ao)
+{
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f), three = _mm256_set1_ps(3.0f), two = _mm256_set1_ps(2.0f);
+    const __m256 width = _mm256_set1_ps(float(c.width)), height = _mm256_set1_ps(float(c.height));
+    const __m256 maxX = _mm256_set1_ps(float(c.width - 1)), maxY = _mm256_set1_ps(float(c.height - 1));
+    const __m256 radius = _mm256_set1_ps(c.radius), bias = _mm256_set1_ps(c.bias);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 count = _mm256_set1_ps(float(SSAO_KERNEL_SIZE));
+    const float* P = c.projection;
+
+    int x = x0;
+    for (; x + 8 <= x1; x += 8)
+    {
+        size_t index = size_t(y) * c.width + x;
+        __m256 px = _mm256_loadu_ps(c.x + index);
+        __m256 py = _mm256_loadu_ps(c.y + index);
+        __m256 pz = _mm256_loadu_ps(c.z + index);
+        __m256 nx = _mm256_loadu_ps(c.nx + index);
+        __m256 ny = _mm256_loadu_ps(c.ny + index);
+        __m256 nz = _mm256_loadu_ps(c.nz + index);
+        __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz))));
+        nx = _mm256_mul_ps(nx, inv);
+        ny = _mm256_mul_ps(ny, inv);
+        nz = _mm256_mul_ps(nz, inv);
+
+        __m256 rx = _mm256_loadu_ps(c.noiseX[y % SSAO_NOISE_SIZE] + x % SSAO_NOISE_SIZE);
+        __m256 ry = _mm256_loadu_ps(c.noiseY[y % SSAO_NOISE_SIZE] + x % SSAO_NOISE_SIZE);
+
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(rx, nx), _mm256_mul_ps(ry, ny));
+        __m256 tx = _mm256_sub_ps(rx, _mm256_mul_ps(nx, d));
+        __m256 ty = _mm256_sub_ps(ry, _mm256_mul_ps(ny, d));
+        __m256 tz = _mm256_sub_ps(zero, _mm256_mul_ps(nz, d));
+        inv = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(tx, tx), _mm256_mul_ps(ty, ty)), _mm256_mul_ps(tz, tz))));
+        tx = _mm256_mul_ps(tx, inv);
+        ty = _mm256_mul_ps(ty, inv);
+        tz = _mm256_mul_ps(tz, inv);
+        __m256 bx = _mm256_sub_ps(_mm256_mul_ps(ny, tz), _mm256_mul_ps(nz, ty));
+        __m256 by = _mm256_sub_ps(_mm256_mul_ps(nz, tx), _mm256_mul_ps(nx, tz));
+        __m256 bz = _mm256_sub_ps(_mm256_mul_ps(nx, ty), _mm256_mul_ps(ny, tx));
+
+        __m256 occlusion = zero;
+        for (int k = 0; k < SSAO_KERNEL_SIZE; k++)
+        {
+            __m256 kx = _mm256_set1_ps(c.kernel[3 * k]);
+            __m256 ky = _mm256_set1_ps(c.kernel[3 * k + 1]);
+            __m256 kz = _mm256_set1_ps(c.kernel[3 * k + 2]);
+            __m256 sx = _mm256_add_ps(px, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(tx, kx), _mm256_mul_ps(bx, ky)), _mm256_mul_ps(nx, kz)), radius));
+            __m256 sy = _mm256_add_ps(py, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(ty, kx), _mm256_mul_ps(by, ky)), _mm256_mul_ps(ny, kz)), radius));
+            __m256 sz = _mm256_add_ps(pz, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(tz, kx), _mm256_mul_ps(bz, ky)), _mm256_mul_ps(nz, kz)), radius));
+
+            __m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(P[0]), sx),
+                _mm256_mul_ps(_mm256_set1_ps(P[4]), sy)), _mm256_mul_ps(_mm256_set1_ps(P[8]), sz)), _mm256_set1_ps(P[12]));
+            __m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(P[1]), sx),
+                _mm256_mul_ps(_mm256_set1_ps(P[5]), sy)), _mm256_mul_ps(_mm256_set1_ps(P[9]), sz)), _mm256_set1_ps(P[13]));
+            __m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(P[3]), sx),
+                _mm256_mul_ps(_mm256_set1_ps(P[7]), sy)), _mm256_mul_ps(_mm256_set1_ps(P[11]), sz)), _mm256_set1_ps(P[15]));
+            __m256 u = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(cx, cw), half), half);
+            __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(cy, cw), half), half);
+
+            //  max with zero as second operand also maps NaN to zero
+            __m256 fx = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(_mm256_mul_ps(u, width)), zero), maxX);
+            __m256 fy = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(_mm256_mul_ps(v, height)), zero), maxY);
+            __m256i texel = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fy),
+                _mm256_set1_epi32(c.width)), _mm256_cvttps_epi32(fx));
+            __m256 sampleDepth = _mm256_i32gather_ps(c.z, texel, 4);
+
+            __m256 range = _mm256_div_ps(radius, _mm256_andnot_ps(signMask, _mm256_sub_ps(pz, sampleDepth)));
+            range = _mm256_min_ps(_mm256_max_ps(range, zero), one);
+            range = _mm256_mul_ps(_mm256_mul_ps(range, range), _mm256_sub_ps(three, _mm256_mul_ps(two, range)));
+            __m256 mask = _mm256_cmp_ps(sampleDepth, _mm256_add_ps(sz, bias), _CMP_GE_OQ);
+            occlusion = _mm256_add_ps(occlusion, _mm256_and_ps(mask, range));
+        }
+        __m256 result = _mm256_sub_ps(one, _mm256_div_ps(occlusion, count));
+        result = _mm256_blendv_ps(result, one, _mm256_cmp_ps(pz, zero, _CMP_EQ_OQ));
+        _mm256_storeu_ps(ao + index, result);
+    }
+    aoSpanScalar(c, y, x, x1, ao);
+}
+
+#endif
+
+void SSAOReference::computeAO(const SoftwareGBuffer& gBuffer, const float projection[16],
+    std::vector<float>& ao) const
+{
+    AOContext c;
+    c.width = gBuffer.width;
+    c.height = gBuffer.height;
+    c.x = gBuffer.x.data();
+    c.y = gBuffer.y.data();
+    c.z = gBuffer.z.data();
+    c.nx = gBuffer.nx.data();
+    c.ny = gBuffer.ny.data();
+    c.nz = gBuffer.nz.data();
+    c.kernel = this->_kernel;
+    c.projection = projection;
+    c.radius = this->_radius;
+    c.bias = this->_bias;
+
+    //  the noise texture tiles over the screen with nearest filtering
+    for (int j = 0; j < SSAO_NOISE_SIZE; j++)
+    {
+        for (int i = 0; i < SSAO_NOISE_SIZE + 8; i++)
+        {
+            const float* n = this->_noise + 3 * (j * SSAO_NOISE_SIZE + i % SSAO_NOISE_SIZE);
+            float inv = 1.0f / std::sqrt(n[0] * n[0] + n[1] * n[1]);
+            c.noiseX[j][i] = n[0] * inv;
+            c.noiseY[j][i] = n[1] * inv;
+        }
+    }
+
+    void (*span)(const AOContext&, int, int, int, float*) = aoSpanScalar;
+#ifdef SSAO_REFERENCE_X86
+    if (this->_simdLevel == SIMD_AVX2)
+        span = aoSpanAVX2;
+    else if (this->_simdLevel == SIMD_SSE41)
+        span = aoSpanSSE41;
+#endif
+
+    ao.resize(size_t(c.width) * c.height);
+    float* out = ao.data();
+    int tilesX = (c.width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (c.height + TILE_SIZE - 1) / TILE_SIZE;
+    parallelFor(tilesX * tilesY, this->_threadCount, [&](int tile) {
+        int x0 = (tile % tilesX) * TILE_SIZE;
+        int y0 = (tile / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, c.width);
+        int y1 = std::min(y0 + TILE_SIZE, c.height);
+        for (int y = y0; y < y1; y++)
+            span(c, y, x0, x1, out);
+    });
+}
+
+/* Blur */
+
+//  one direction of the bilateral blur, for rows [y0, y1)
+static void blurRows(const SoftwareGBuffer& g, const float* in, float* out,
+    int dx, int dy, int radius, const std::vector<float>& gaussian,
+    float depthSharpness, float normalPower, int y0, int y1)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = 0; x < g.width; x++)
+        {
+            size_t index = size_t(y) * g.width + x;
+            float z = g.z[index];
+            float nx = g.nx[index], ny = g.ny[index], nz = g.nz[index];
+
+            float result = in[index];
+            float weightSum = 1.0f;
+            for (int i = -radius; i <= radius; i++)
+            {
+                if (i == 0)
+                    continue;
+                int sx = std::min(std::max(x + i * dx, 0), g.width - 1);
+                int sy = std::min(std::max(y + i * dy, 0), g.height - 1);
+                size_t sample = size_t(sy) * g.width + sx;
+
+                float depthDiff = std::fabs(g.z[sample] - z) / std::max(std::fabs(z), 1e-3f);
+                float cosine = g.nx[sample] * nx + g.ny[sample] * ny + g.nz[sample] * nz;
+                float weight = gaussian[i + radius]
+                    * std::exp(-depthDiff * depthSharpness)
+                    * std::pow(std::max(cosine, 0.0f), normalPower);
+
+                result += in[sample] * weight;
+                weightSum += weight;
+            }
+            out[index] = result / weightSum;
+        }
+    }
+}
+
+void SSAOReference::blur(const SoftwareGBuffer& gBuffer, const std::vector<float>& ao,
+    std::vector<float>& result) const
+{
+    int radius = this->_blurRadius;
+    float sigma = std::max(radius * 0.5f, 0.5f);
+    std::vector<float> gaussian(2 * radius + 1);
+    for (int i = -radius; i <= radius; i++)
+        gaussian[i + radius] = std::exp(float(i * i) * (-0.5f / (sigma * sigma)));
+
+    std::vector<float> horizontal(ao.size());
+    result.resize(ao.size());
+    int bands = (gBuffer.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    const float* passIn[2] = { ao.data(), horizontal.data() };
+    float* passOut[2] = { horizontal.data(), result.data() };
+    for (int pass = 0; pass < 2; pass++)
+    {
+        parallelFor(bands, this->_threadCount, [&](int band) {
+            int y0 = band * BAND_HEIGHT;
+            blurRows(gBuffer, passIn[pass], passOut[pass], pass == 0 ? 1 : 0, pass == 0 ? 0 : 1,
+                radius, gaussian, this->_blurDepthSharpness, this->_blurNormalPower,
+                y0, std::min(y0 + BAND_HEIGHT, gBuffer.height));
+        });
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef SSAOREFERENCE_HPP
+#define SSAOREFERENCE_HPP
+
+#include <vector>
+
+#include "ssaokernel.hpp"
+
+//  g-buffer of the CPU reference implementation, in structure-of-arrays
+//  layout (one plane per component). rows go from bottom to top, like in
+//  GL textures. positions and normals are in view space; the position is
+//  zero where there is no geometry, like the cleared position texture.
+struct SoftwareGBuffer
+{
+    int width, height;
+    std::vector<float> x, y, z;
+    std::vector<float> nx, ny, nz;
+    std::vector<float> depth;   // window-space depth, for the depth test
+
+    SoftwareGBuffer() : width(0), height(0) {}
+
+    //  resize and clear to the background
+    void resize(int width, int height);
+};
+
+//  CPU implementation of the hemisphere ssao pipeline, mirroring
+//  fs_geom.glsl -> fs_ssao.glsl -> fs_ssao_blur.glsl at full resolution
+//  (positions stored in the g-buffer, all kernel samples, no temporal
+//  accumulation). It uses the kernel and noise of the GPU renderer and
+//  needs no GL driver, so it serves as golden reference and as AO baker.
+//
+//  The image is split into tiles that a number of threads process. The
+//  kernel loop runs on 8 (AVX2) or 4 (SSE4.1) pixels at once; all SIMD
+//  levels compute bit-identical results.
+//  Matrices are column-major, as in OpenGL and QMatrix4x4::constData().
+class SSAOReference
+{
+public:
+
+    //  instruction sets for the kernel loop
+    enum SIMDLevel
+    {
+        SIMD_Scalar,
+        SIMD_SSE41,
+        SIMD_AVX2,
+        SIMDLevelCount
+    };
+
+    //  the best level this CPU supports
+    static SIMDLevel supportedSIMDLevel();
+
+    //  short level name, e.g. for benchmark output
+    static const char* simdLevelName(int level);
+
+private:
+
+    //  same samples as the GPU renderer
+    float _kernel[SSAO_KERNEL_SIZE * 3];
+    float _noise[SSAO_NOISE_SIZE * SSAO_NOISE_SIZE * 3];
+
+    int _threadCount;
+    SIMDLevel _simdLevel;
+
+    //  ssao and blur parameters, see SSAORenderer
+    float _radius, _bias;
+    int _blurRadius;
+    float _blurDepthSharpness, _blurNormalPower;
+
+public:
+    SSAOReference();
+
+    //  number of worker threads (default: all hardware threads)
+    int threadCount() const { return _threadCount; }
+    void setThreadCount(int count);
+
+    //  instruction set of the kernel loop (default: the best supported)
+    SIMDLevel simdLevel() const { return _simdLevel; }
+    void setSIMDLevel(SIMDLevel level);
+
+    float radius() const { return _radius; }
+    void setRadius(float radius) { _radius = radius; }
+    float bias() const { return _bias; }
+    void setBias(float bias) { _bias = bias; }
+    int blurRadius() const { return _blurRadius; }
+    void setBlurRadius(int radius) { _blurRadius = radius < 0 ? 0 : radius; }
+    float blurDepthSharpness() const { return _blurDepthSharpness; }
+    void setBlurDepthSharpness(float sharpness) { _blurDepthSharpness = sharpness; }
+    float blurNormalPower() const { return _blurNormalPower; }
+    void setBlurNormalPower(float power) { _blurNormalPower = power; }
+
+    //  fs_geom.glsl: rasterize indexed triangles into the g-buffer, with
+    //  depth test and back face culling. positions and normals hold xyz
+    //  per vertex. the g-buffer is not cleared, so several meshes can be
+    //  drawn one after another.
+    void rasterize(SoftwareGBuffer& gBuffer,
+        const float* positions, const float* normals,
+        const unsigned int* indices, int indexCount,
+        const float modelview[16], const float normalMatrix[9],
+        const float projection[16]) const;
+
+    //  fs_ssao.glsl: visibility (1 = unoccluded) per pixel.
+    //  background pixels get 1.
+    void computeAO(const SoftwareGBuffer& gBuffer, const float projection[16],
+        std::vector<float>& ao) const;
+
+    //  fs_ssao_blur.glsl: separable bilateral blur, horizontal then vertical
+    void blur(const SoftwareGBuffer& gBuffer, const std::vector<float>& ao,
+        std::vector<float>& result) const;
+};
+
+#endif
@@ -0,0 +1,358 @@
+//  CPU reference benchmark: rasterizes a procedural scene into a software
+//  g-buffer, computes and blurs ssao on the CPU, and reports timings per
+//  thread count as JSON. It can also write the ao image, e.g. for baking
+//  or to compare against the GPU renderer. No GL context is needed.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ssaoreference.hpp"
+
+//  triangle mesh with xyz positions and normals
+struct Mesh
+{
+    std::vector<float> positions, normals;
+    std::vector<unsigned int> indices;
+
+    void addVertex(float x, float y, float z, float nx, float ny, float nz)
+    {
+        positions.push_back(x);
+        positions.push_back(y);
+        positions.push_back(z);
+        normals.push_back(nx);
+        normals.push_back(ny);
+        normals.push_back(nz);
+    }
+
+    //  quad from four counter-clockwise corners and a normal
+    void addQuad(const float c[4][3], const float n[3])
+    {
+        unsigned int base = positions.size() / 3;
+        for (int i = 0; i < 4; i++)
+            addVertex(c[i][0], c[i][1], c[i][2], n[0], n[1], n[2]);
+        unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; i++)
+            indices.push_back(base + quad[i]);
+    }
+};
+
+//  ground plane, a sphere and a box: contact shadows, creases and curved
+//  surfaces, roughly where the teapot is in the interactive application
+static void createScene(Mesh& mesh)
+{
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+    const float ground[4][3] = { { -1.5f, 0.0f, 1.5f }, { 1.5f, 0.0f, 1.5f },
+        { 1.5f, 0.0f, -1.5f }, { -1.5f, 0.0f, -1.5f } };
+    mesh.addQuad(ground, up);
+
+    //  sphere resting on the plane
+    const float cx = -0.3f, cy = 0.25f, cz = 0.0f, r = 0.25f;
+    const int rings = 32, segments = 64;
+    unsigned int base = mesh.positions.size() / 3;
+    for (int i = 0; i <= rings; i++)
+    {
+        float theta = float(M_PI) * i / rings;
+        for (int j = 0; j <= segments; j++)
+        {
+            float phi = 2.0f * float(M_PI) * j / segments;
+            float nx = std::sin(theta) * std::cos(phi);
+            float ny = std::cos(theta);
+            float nz = -std::sin(theta) * std::sin(phi);
+            mesh.addVertex(cx + r * nx, cy + r * ny, cz + r * nz, nx, ny, nz);
+        }
+    }
+    for (int i = 0; i < rings; i++)
+    {
+        for (int j = 0; j < segments; j++)
+        {
+            unsigned int a = base + i * (segments + 1) + j;
+            unsigned int b = a + segments + 1;
+            unsigned int quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+            for (int k = 0; k < 6; k++)
+                mesh.indices.push_back(quad[k]);
+        }
+    }
+
+    //  box standing on the plane
+    const float x0 = 0.15f, x1 = 0.55f, y0 = 0.0f, y1 = 0.3f, z0 = -0.35f, z1 = 0.05f;
+    const float faces[6][4][3] = {
+        { { x0, y0, z1 }, { x1, y0, z1 }, { x1, y1, z1 }, { x0, y1, z1 } },
+        { { x1, y0, z0 }, { x0, y0, z0 }, { x0, y1, z0 }, { x1, y1, z0 } },
+        { { x0, y0, z0 }, { x0, y0, z1 }, { x0, y1, z1 }, { x0, y1, z0 } },
+        { { x1, y0, z1 }, { x1, y0, z0 }, { x1, y1, z0 }, { x1, y1, z1 } },
+        { { x0, y1, z1 }, { x1, y1, z1 }, { x1, y1, z0 }, { x0, y1, z0 } },
+        { { x0, y0, z0 }, { x1, y0, z0 }, { x1, y0, z1 }, { x0, y0, z1 } } };
+    const float normals[6][3] = { { 0, 0, 1 }, { 0, 0, -1 }, { -1, 0, 0 },
+        { 1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 } };
+    for (int i = 0; i < 6; i++)
+        mesh.addQuad(faces[i], normals[i]);
+}
+
+//  the camera of SSAORenderer::defaultCamera(), as column-major matrices
+static void defaultCamera(int width, int height, float P[16], float V[16])
+{
+    float aspect = float(width) / float(height);
+    float nearPlane = 0.05f, farPlane = 10.0f;
+    float f = 1.0f / std::tan(50.0f * float(M_PI) / 360.0f);
+    std::memset(P, 0, 16 * sizeof(float));
+    P[0] = f / aspect;
+    P[5] = f;
+    P[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+    P[11] = -1.0f;
+    P[14] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+
+    //  lookAt from (0, 0.7, 1.4) to the origin, y up
+    float eye[3] = { 0.0f, 0.7f, 1.4f };
+    float fw[3] = { -eye[0], -eye[1], -eye[2] };
+    float l = std::sqrt(fw[0] * fw[0] + fw[1] * fw[1] + fw[2] * fw[2]);
+    for (int i = 0; i < 3; i++)
+        fw[i] /= l;
+    float s[3] = { -fw[2], 0.0f, fw[0] };   // cross(fw, up)
+    l = std::sqrt(s[0] * s[0] + s[2] * s[2]);
+    s[0] /= l;
+    s[2] /= l;
+    float u[3] = { s[1] * fw[2] - s[2] * fw[1], s[2] * fw[0] - s[0] * fw[2], s[0] * fw[1] - s[1] * fw[0] };
+    std::memset(V, 0, 16 * sizeof(float));
+    for (int i = 0; i < 3; i++)
+    {
+        V[4 * i + 0] = s[i];
+        V[4 * i + 1] = u[i];
+        V[4 * i + 2] = -fw[i];
+    }
+    V[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+    V[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+    V[14] = fw[0] * eye[0] + fw[1] * eye[1] + fw[2] * eye[2];
+    V[15] = 1.0f;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples.empty() ? 0.0 : samples[samples.size() / 2];
+}
+
+//  8 bit binary PGM, top row first
+static bool writePGM(const char* fileName, const std::vector<float>& image, int width, int height)
+{
+    FILE* f = std::fopen(fileName, "wb");
+    if (!f)
+        return false;
+    std::fprintf(f, "P5\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row(width);
+    for (int y = height - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float v = std::min(std::max(image[size_t(y) * width + x], 0.0f), 1.0f);
+            row[x] = static_cast<unsigned char>(v * 255.0f + 0.5f);
+        }
+        std::fwrite(row.data(), 1, width, f);
+    }
+    return std::fclose(f) == 0;
+}
+
+static void usage()
+{
+    std::fprintf(stderr,
+        "Usage: ssaoreferencebench [options]\n"
+        "CPU reference SSAO benchmark with timings per thread count.\n\n"
+        "  --width <pixels>        Image width (default 1920).\n"
+        "  --height <pixels>       Image height (default 1080).\n"
+        "  --threads <list>        Comma-separated thread counts (default 1 and all).\n"
+        "  --iterations <n>        Measured iterations per thread count (default 5).\n"
+        "  --simd <level>          scalar, sse4.1 or avx2 (default: best supported).\n"
+        "  --ao-radius <radius>    SSAO kernel radius in view-space units (default 0.5).\n"
+        "  --blur-radius <texels>  Blur radius in texels per direction (default 2).\n"
+        "  --image <file>          Write the blurred ao as PGM.\n"
+        "  --output <file>         Write JSON to this file instead of stdout.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 1920, height = 1080, iterations = 5;
+    std::vector<int> threadCounts;
+    const char* imageFile = NULL;
+    const char* outputFile = NULL;
+    SSAOReference reference;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h")
+        {
+            usage();
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (option == "--width")
+            width = std::max(std::atoi(value), 1);
+        else if (option == "--height")
+            height = std::max(std::atoi(value), 1);
+        else if (option == "--iterations")
+            iterations = std::max(std::atoi(value), 1);
+        else if (option == "--ao-radius")
+            reference.setRadius(float(std::atof(value)));
+        else if (option == "--blur-radius")
+            reference.setBlurRadius(std::atoi(value));
+        else if (option == "--image")
+            imageFile = value;
+        else if (option == "--output")
+            outputFile = value;
+        else if (option == "--threads")
+        {
+            for (const char* p = value; *p; p++)
+            {
+                threadCounts.push_back(std::max(std::atoi(p), 1));
+                while (p[1] && *p != ',')
+                    p++;
+            }
+        }
+        else if (option == "--simd")
+        {
+            int level = 0;
+            while (level < SSAOReference::SIMDLevelCount
+                && std::strcmp(value, SSAOReference::simdLevelName(level)) != 0)
+                level++;
+            if (level == SSAOReference::SIMDLevelCount)
+            {
+                std::fprintf(stderr, "unknown SIMD level %s\n", value);
+                return 1;
+            }
+            if (level > SSAOReference::supportedSIMDLevel())
+            {
+                std::fprintf(stderr, "SIMD level %s is not supported by this CPU\n", value);
+                return 1;
+            }
+            reference.setSIMDLevel(SSAOReference::SIMDLevel(level));
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (threadCounts.empty())
+    {
+        threadCounts.push_back(1);
+        if (reference.threadCount() > 1)
+            threadCounts.push_back(reference.threadCount());
+    }
+
+    Mesh mesh;
+    createScene(mesh);
+    float P[16], V[16], N[9];
+    defaultCamera(width, height, P, V);
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            N[3 * i + j] = V[4 * i + j];   // V is a rotation plus translation
+
+    SoftwareGBuffer gBuffer;
+    std::vector<float> ao, blurred;
+    double megapixels = double(width) * height * 1e-6;
+
+    std::string runs;
+    for (size_t t = 0; t < threadCounts.size(); t++)
+    {
+        reference.setThreadCount(threadCounts[t]);
+        std::vector<double> rasterizeMs, ssaoMs, blurMs;
+        for (int i = 0; i < iterations; i++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            gBuffer.resize(width, height);
+            reference.rasterize(gBuffer, mesh.positions.data(), mesh.normals.data(),
+                mesh.indices.data(), mesh.indices.size(), V, N, P);
+            rasterizeMs.push_back(elapsedMs(start));
+            start = std::chrono::steady_clock::now();
+            reference.computeAO(gBuffer, P, ao);
+            ssaoMs.push_back(elapsedMs(start));
+            start = std::chrono::steady_clock::now();
+            reference.blur(gBuffer, ao, blurred);
+            blurMs.push_back(elapsedMs(start));
+        }
+        double rasterize = median(rasterizeMs), ssao = median(ssaoMs), blur = median(blurMs);
+        char run[512];
+        std::snprintf(run, sizeof(run),
+            "%s        {\n"
+            "            \"threads\": %d,\n"
+            "            \"rasterize_ms\": %.3f,\n"
+            "            \"ssao_ms\": %.3f,\n"
+            "            \"blur_ms\": %.3f,\n"
+            "            \"ssao_mpixels_per_s\": %.2f,\n"
+            "            \"blur_mpixels_per_s\": %.2f,\n"
+            "            \"total_mpixels_per_s\": %.2f\n"
+            "        }",
+            t == 0 ? "" : ",\n", threadCounts[t], rasterize, ssao, blur,
+            megapixels / ssao * 1e3, megapixels / blur * 1e3,
+            megapixels / (rasterize + ssao + blur) * 1e3);
+        runs += run;
+    }
+
+    //  all SIMD levels must agree with the scalar code
+    float maxDifference = 0.0f;
+    if (reference.simdLevel() != SSAOReference::SIMD_Scalar)
+    {
+        std::vector<float> scalar;
+        SSAOReference::SIMDLevel level = reference.simdLevel();
+        reference.setSIMDLevel(SSAOReference::SIMD_Scalar);
+        reference.computeAO(gBuffer, P, scalar);
+        reference.setSIMDLevel(level);
+        for (size_t i = 0; i < ao.size(); i++)
+            maxDifference = std::max(maxDifference, std::fabs(ao[i] - scalar[i]));
+    }
+
+    double meanAO = 0.0;
+    for (size_t i = 0; i < blurred.size(); i++)
+        meanAO += blurred[i];
+    meanAO /= std::max(blurred.size(), size_t(1));
+
+    if (imageFile && !writePGM(imageFile, blurred, width, height))
+    {
+        std::fprintf(stderr, "cannot write %s\n", imageFile);
+        return 1;
+    }
+
+    FILE* out = outputFile ? std::fopen(outputFile, "w") : stdout;
+    if (!out)
+    {
+        std::fprintf(stderr, "cannot write %s\n", outputFile);
+        return 1;
+    }
+    std::fprintf(out,
+        "{\n"
+        "    \"width\": %d,\n"
+        "    \"height\": %d,\n"
+        "    \"iterations\": %d,\n"
+        "    \"triangles\": %d,\n"
+        "    \"simd\": \"%s\",\n"
+        "    \"simd_max_difference\": %g,\n"
+        "    \"ao_radius\": %g,\n"
+        "    \"blur_radius\": %d,\n"
+        "    \"mean_ao\": %.4f,\n"
+        "    \"runs\": [\n%s\n    ]\n"
+        "}\n",
+        width, height, iterations, int(mesh.indices.size() / 3),
+        SSAOReference::simdLevelName(reference.simdLevel()), maxDifference,
+        reference.radius(), reference.blurRadius(), meanAO, runs.c_str());
+    if (outputFile && std::fclose(out) != 0)
+    {
+        std::fprintf(stderr, "cannot write %s\n", outputFile);
+        return 1;
+    }
+    return 0;
+}
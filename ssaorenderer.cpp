@@ -0,0 +1,2460 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <cstring>
+#include <random>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtMath>
+#include <QVector2D>
+
+#include "cgbase/cggeometries.hpp"
+#include "cgbase/cgtools.hpp"
+
+#include "ssaokernel.hpp"
+#include "ssaorenderer.hpp"
+
+#define LIGHT_POS_DISTANCE 1.7f
+
+//  default shadow map resolution per cascade
+#define SHADOW_MAP_WIDTH 1024
+
+//  blend between logarithmic (1) and uniform (0) cascade splits
+#define SHADOW_SPLIT_LAMBDA 0.5f
+
+//  cascade sizes are multiples of the scene size divided by this
+#define SHADOW_EXTENT_STEPS 32
+
+//  workgroup tile size of cs_ssao.glsl
+#define COMPUTE_TILE_SIZE 16
+
+//  the fused compute blur keeps its border in shared memory,
+//  which limits its radius
+#define COMPUTE_MAX_BLUR_RADIUS 4
+
+//  workgroup tile size of cs_lights.glsl, the tile of its light culling
+#define LIGHT_TILE_SIZE 16
+
+//  most local lights, and the area over the plane they are scattered in
+#define MAX_LOCAL_LIGHTS 65536
+#define LOCAL_LIGHT_EXTENT 1.5f
+
+//  uniform buffer binding points of the blocks in frame.glsl and
+//  fs_ssao.glsl / cs_ssao.glsl
+#define FRAME_CONSTANTS_BINDING 0
+#define SSAO_KERNEL_BINDING 1
+
+//  ring buffer bytes per frame to start with; it grows with the instances
+#define RING_REGION_SIZE (64 * 1024)
+
+//  function to generate 2D texture with fix filtering params.
+void createTexture(GLsizei width, GLsizei height,
+    GLint inFormat, GLenum format, GLenum type,
+    GLint filtering, GLint wrapping,
+    const GLvoid* data, unsigned int& texture)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, inFormat,
+        width, height, 0, format, type, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filtering);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtering);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapping);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapping);
+    CG_ASSERT_GLCHECK();
+}
+
+//  function to attach textures as the color targets of a new FBO
+void createFramebuffer(int count, const unsigned int* textures, unsigned int& fbo)
+{
+    unsigned int attachments[8];
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    for (int i = 0; i < count; i++)
+    {
+        attachments[i] = GL_COLOR_ATTACHMENT0 + i;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[i], GL_TEXTURE_2D, textures[i], 0);
+    }
+    glDrawBuffers(count, attachments);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    CG_ASSERT_GLCHECK();
+}
+
+//  function to load a glsl file and expand its #include "file" lines
+//  (one level only, which is all our shaders need)
+QString loadShaderFile(const char* filename)
+{
+    QString code = Cg::loadFile(filename);
+    QStringList lines = code.split('\n');
+    for (int i = 0; i < lines.size(); i++)
+    {
+        QString line = lines[i].trimmed();
+        if (line.startsWith("#include"))
+        {
+            QString included = line.mid(8).trimmed();
+            included = included.mid(1, included.length() - 2);
+            lines[i] = Cg::loadFile(included.toLatin1().constData());
+        }
+    }
+    return lines.join("\n");
+}
+
+//  directory of the program binary cache, see SSAORenderer::programCacheDirectory
+static QString programCacheDir;
+static bool programCacheDirSet = false;
+
+//  try to load a linked program binary from path into program
+bool loadProgramBinary(QOpenGLShaderProgram& program, const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray data = file.readAll();
+    if (data.size() <= int(sizeof(GLenum)))
+        return false;
+
+    //  a format the driver does not know would raise a GL error
+    GLenum format;
+    std::memcpy(&format, data.constData(), sizeof(GLenum));
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    QVector<GLint> formats(formatCount);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    if (!formats.contains(GLint(format)))
+        return false;
+
+    //  the driver may still reject it, e.g. after an update
+    glProgramBinary(program.programId(), format,
+        data.constData() + sizeof(GLenum), data.size() - sizeof(GLenum));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program.programId(), GL_LINK_STATUS, &linked);
+    CG_ASSERT_GLCHECK();
+
+    //  without shaders, link() accepts the program as it is, once linked
+    return linked && program.link();
+}
+
+//  store the binary of the linked program at path, prefixed by its format
+void saveProgramBinary(QOpenGLShaderProgram& program, const QString& path)
+{
+    GLint length = 0;
+    glGetProgramiv(program.programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    QByteArray data(int(sizeof(GLenum)) + length, Qt::Uninitialized);
+    GLenum format = 0;
+    glGetProgramBinary(program.programId(), length, NULL, &format, data.data() + sizeof(GLenum));
+    std::memcpy(data.data(), &format, sizeof(GLenum));
+    CG_ASSERT_GLCHECK();
+
+    //  write atomically, several processes may share the cache
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (file.open(QIODevice::WriteOnly) && file.write(data) == data.size())
+        file.commit();
+}
+
+//  function to link a program from shader stages. linked binaries are
+//  cached on disk, keyed by the sources and the driver, so that later runs
+//  skip compiling. a missing or rejected binary falls back to the sources.
+void linkProgram(QOpenGLShaderProgram& program, int count,
+    const QOpenGLShader::ShaderType* types, const QString* sources)
+{
+    //  allow to rebuild an existing program, e.g. with other defines
+    program.removeAllShaders();
+    program.create();
+
+    QString path;
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    QString directory = SSAORenderer::programCacheDirectory();
+    if (!directory.isEmpty() && formatCount > 0)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+        hash.addData(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+        hash.addData(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        for (int i = 0; i < count; i++)
+        {
+            hash.addData(QByteArray::number(int(types[i])));
+            hash.addData(sources[i].toUtf8());
+        }
+        path = directory + "/" + QString(hash.result().toHex()) + ".bin";
+
+        if (loadProgramBinary(program, path))
+            return;
+    }
+
+    for (int i = 0; i < count; i++)
+        program.addShaderFromSourceCode(types[i], sources[i]);
+    if (!path.isEmpty())
+        glProgramParameteri(program.programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    program.link();
+    CG_ASSERT_GLCHECK();
+
+    if (!path.isEmpty() && program.isLinked())
+        saveProgramBinary(program, path);
+}
+
+//  function to assign the uniform blocks of a program their binding
+//  points; the GLSL version of the non-compute stages has no binding
+//  layout qualifier. also needed after loading a binary, which resets them.
+void bindUniformBlocks(QOpenGLShaderProgram& program)
+{
+    static const char* const names[] = { "FrameConstants", "SSAOKernel" };
+    static const GLuint bindings[] = { FRAME_CONSTANTS_BINDING, SSAO_KERNEL_BINDING };
+    for (int i = 0; i < 2; i++)
+    {
+        GLuint index = glGetUniformBlockIndex(program.programId(), names[i]);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program.programId(), index, bindings[i]);
+    }
+    CG_ASSERT_GLCHECK();
+}
+
+//  function to build shader program from glsl code
+//  inline bits indicate if this shader module is a file to be loaded or not
+//  0x00000002 means the second least significant bit (fragment shader) is just
+//  a string, no need to perform I/O load
+//  defines are inserted right after the version line of both shaders
+void createShaderProgram(QOpenGLShaderProgram& program,
+    const char* vs, const char* fs, int inlineBits,
+    const QString& defines = QString())
+{
+    QOpenGLShader::ShaderType types[2] = { QOpenGLShader::Vertex, QOpenGLShader::Fragment };
+    QString sources[2];
+
+    sources[0] = Cg::prependGLSLVersion(defines
+        + (inlineBits & 0x00000001 ? QString(vs) : loadShaderFile(vs)));
+    sources[1] = Cg::prependGLSLVersion(defines
+        + (inlineBits & 0x00000002 ? QString(fs) : loadShaderFile(fs)));
+
+    ::linkProgram(program, 2, types, sources);
+    ::bindUniformBlocks(program);
+}
+
+//  function to build a compute shader program from a glsl file.
+//  compute shaders need GLSL 4.30, so the version is given explicitly
+//  instead of using the one the other stages are compiled with.
+void createComputeProgram(QOpenGLShaderProgram& program,
+    const char* cs, const QString& defines = QString())
+{
+    QOpenGLShader::ShaderType type = QOpenGLShader::Compute;
+    QString source = QString("#version 450 core\n") + defines + loadShaderFile(cs);
+
+    ::linkProgram(program, 1, &type, &source);
+    ::bindUniformBlocks(program);
+}
+
+//  directory of the mesh cache, see SSAORenderer::meshCacheDirectory
+static QString meshCacheDir;
+static bool meshCacheDirSet = false;
+
+//  path of the mesh file converted from an OBJ file, keyed by its
+//  contents, so that a changed file is a cache miss. empty without a cache.
+QString meshCachePath(const char* fileName)
+{
+    QString directory = SSAORenderer::meshCacheDirectory();
+    QFile file(fileName);
+    if (directory.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return QString();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(file.readAll());
+    return directory + "/" + QFileInfo(fileName).completeBaseName()
+        + "-" + QString(hash.result().toHex()) + ".mesh";
+}
+
+QString SSAORenderer::programCacheDirectory()
+{
+    if (!programCacheDirSet)
+    {
+        programCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if (!programCacheDir.isEmpty())
+            programCacheDir += "/programs";
+        programCacheDirSet = true;
+    }
+    return programCacheDir;
+}
+
+void SSAORenderer::setProgramCacheDirectory(const QString& directory)
+{
+    programCacheDir = directory;
+    programCacheDirSet = true;
+}
+
+QString SSAORenderer::meshCacheDirectory()
+{
+    if (!meshCacheDirSet)
+    {
+        meshCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if (!meshCacheDir.isEmpty())
+            meshCacheDir += "/meshes";
+        meshCacheDirSet = true;
+    }
+    return meshCacheDir;
+}
+
+void SSAORenderer::setMeshCacheDirectory(const QString& directory)
+{
+    meshCacheDir = directory;
+    meshCacheDirSet = true;
+}
+
+const char* SSAORenderer::passName(int pass)
+{
+    static const char* names[PassCount] = {
+        "shadow", "geometry", "ao_downsample", "hiz", "ssao", "temporal", "blur", "ao_upsample", "lights", "lighting"
+    };
+    return (pass >= 0 && pass < PassCount) ? names[pass] : "unknown";
+}
+
+const char* SSAORenderer::aoTechniqueName(int technique)
+{
+    static const char* names[AOTechniqueCount] = { "hemisphere", "hbao", "gtao" };
+    return (technique >= 0 && technique < AOTechniqueCount) ? names[technique] : "unknown";
+}
+
+const char* SSAORenderer::shadowFilterName(int filter)
+{
+    static const char* names[ShadowFilterCount] = { "pcf", "hardware", "optimized", "poisson" };
+    return (filter >= 0 && filter < ShadowFilterCount) ? names[filter] : "unknown";
+}
+
+const char* SSAORenderer::lightCullingName(int culling)
+{
+    static const char* names[LightCullingCount] = { "tiled", "naive" };
+    return (culling >= 0 && culling < LightCullingCount) ? names[culling] : "unknown";
+}
+
+int SSAORenderer::shadowFetches(ShadowFilter filter, int pcfSize)
+{
+    //  the bilinear filters fetch every other texel per direction
+    int taps = (pcfSize + 1) / 2;
+    return filter == Shadow_PCF ? pcfSize * pcfSize : taps * taps;
+}
+
+const char* SSAORenderer::qualityName(int quality)
+{
+    static const char* names[QualityCount] = { "low", "medium", "high", "ultra" };
+    return (quality >= 0 && quality < QualityCount) ? names[quality] : "unknown";
+}
+
+SSAORenderer::QualitySettings SSAORenderer::qualitySettings(Quality quality)
+{
+    //  hemisphere samples, hbao directions and steps, gtao slices and
+    //  steps, blur radius, pcf size. high is the default.
+    static const QualitySettings tiers[QualityCount] = {
+        { 16,  4, 3,  1, 3,  1, 1 },
+        { 32,  6, 4,  2, 3,  2, 3 },
+        { 64,  8, 4,  2, 4,  2, 3 },
+        { 64, 12, 6,  4, 6,  4, 5 }
+    };
+    return tiers[std::min(std::max(int(quality), 0), QualityCount - 1)];
+}
+
+void SSAORenderer::defaultCamera(int width, int height, QMatrix4x4& P, QMatrix4x4& V)
+{
+    //  look at the center of the scene from slightly above,
+    //  at the same distance the interactive navigator starts with
+    P.setToIdentity();
+    P.perspective(50.0f, float(width) / float(height), 0.05f, 10.0f);
+    V.setToIdentity();
+    V.lookAt(QVector3D(0.0f, 0.7f, 1.4f), QVector3D(), QVector3D(0.0f, 1.0f, 0.0f));
+}
+
+SSAORenderer::SSAORenderer() :
+    _width(0), _height(0),
+    _kd(0.5f), _ks(0.5f), _shininess(30.0f),
+    _lightAzimuthAngle(0),
+    _modelAngle(0.0f), _animated(true),
+    _reconstructPosition(false), _compactGBuffer(false),
+    _aoDivisor(1), _aoWidth(0), _aoHeight(0),
+    _aoRadius(0.5f),
+    _quality(Quality_High), _pcfSize(3),
+    _aoTechnique(AO_Hemisphere),
+    _blurRadius(2), _blurDepthSharpness(32.0f), _blurNormalPower(8.0f),
+    _computeSSAO(false),
+    _temporal(false), _temporalSamples(16),
+    _temporalBlend(0.1f), _temporalDepthTolerance(0.05f),
+    _historyIndex(0), _historyValid(false), _frameIndex(0),
+    _prg_main(NULL), _prg_ssao(NULL), _prg_ssao_blur(NULL), _prg_ssao_compute(NULL),
+    _mesh_plane(-1), _mesh_model(-1), _sceneObjects(1), _firstModelInstance(0), _drawCalls(0),
+    _meshLoadTime(0.0), _meshCacheHit(false),
+    _shadowCascades(1), _shadowMapSize(SHADOW_MAP_WIDTH), _shadowFilter(Shadow_OptimizedPCF),
+    _shadowStaticValid(false), _shadowStaticVersion(-1), _shadowDynamicVersion(-1), _shadowPassSkipped(false),
+    _hiz(false), _hizLevels(0),
+    _adaptiveAO(false), _tex_ssao_samples(0), _ssaoSamplesLevels(1), _buf_ssao_samples(0), _meanAOSamples(-1.0f),
+    _ubo_ssao_kernel(0),
+    _aoEnabled(true), _shadowsEnabled(true),
+    _localLights(0), _lightCulling(LightCulling_Tiled), _ssbo_lights(0), _tex_local_light(0), _prg_lights(NULL),
+    _lightOverflowTiles(-1),
+    _timingEnabled(false), _timerFrame(0), _passTimesValid(false)
+{
+    this->_lightDir = -QVector3D(1.0f, 1.0f, 0.0f).normalized();
+
+    //  no targets yet, see setupTargets()
+    this->_fbo_geom = this->_fbo_ssao = this->_fbo_ssao_blur = 0;
+    this->_fbo_ssao_blur_tmp = this->_fbo_ssao_full = 0;
+    this->_fbo_ssao_history[0] = this->_fbo_ssao_history[1] = 0;
+    for (int level = 0; level < AO_PYRAMID_LEVELS; level++)
+        this->_aoPyramid[level].fbo = 0;
+    for (int level = 0; level < HIZ_MAX_LEVELS; level++)
+        this->_fbo_hiz[level] = 0;
+    this->_tex_depth = this->_tex_depth_static = 0;
+    this->_ssaoSamplesIssued[0] = this->_ssaoSamplesIssued[1] = false;
+    this->_buf_light_overflow[0] = this->_buf_light_overflow[1] = 0;
+    this->_lightOverflowIssued[0] = this->_lightOverflowIssued[1] = false;
+    for (int c = 0; c < SHADOW_MAX_CASCADES; c++)
+        this->_fbo_depth[c] = this->_fbo_depth_static[c] = 0;
+
+    //  default budgets: 64 taps for the hemisphere, 32 for hbao, 16 for gtao
+    this->_hemisphere.samples = 64;
+    this->_hemisphere.bias = 0.025f;
+    this->_hbao.directions = 8;
+    this->_hbao.steps = 4;
+    this->_hbao.angleBias = 0.1f;
+    this->_gtao.slices = 2;
+    this->_gtao.steps = 4;
+    this->_gtao.falloffRange = 0.615f;
+    for (int i = 0; i < PassCount; i++)
+    {
+        this->_timerQueries[0][i] = this->_timerQueries[1][i] = 0;
+        this->_timerIssued[0][i] = this->_timerIssued[1][i] = false;
+        this->_passTimes[i] = -1.0;
+    }
+}
+
+SSAORenderer::~SSAORenderer()
+{
+    qDeleteAll(this->_programVariants);
+}
+
+//  intialize scene objects
+void SSAORenderer::initializeScene()
+{
+    // Set up buffer objects for the geometry
+    QVector<float> positions, normals, texCoords;
+    QVector<unsigned int> indices;
+    this->_scene.initialize();
+
+    //  setup a plane
+    Cg::quad(positions, normals, texCoords, indices, 1);
+    this->_vao_plane = Cg::createVertexArrayObject(positions, normals, texCoords, indices);
+    this->_idxCount_plane = indices.size();
+    CG_ASSERT_GLCHECK();
+    this->_mesh_plane = this->_scene.addMesh(this->_vao_plane, this->_idxCount_plane, positions);
+
+    //  setup a teapot
+    //  it will be on top of the plane for sure
+    this->_mesh_model = this->loadMesh(":teapot.obj");
+
+    this->setupSceneInstances();
+}
+
+//  on a cache hit, the mesh file is mapped and uploaded from the mapping.
+//  on a miss, the OBJ is parsed, optimized and written to the cache first;
+//  if that fails, or without a cache, the parsed arrays are drawn.
+int SSAORenderer::loadMesh(const char* fileName)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QString path = ::meshCachePath(fileName);
+    MeshFile file;
+    this->_meshCacheHit = !path.isEmpty() && file.open(path);
+
+    QVector<float> positions, normals, texCoords;
+    QVector<unsigned int> indices;
+    if (!this->_meshCacheHit)
+    {
+        Cg::loadObj(fileName, positions, normals, texCoords, indices);
+        if (!path.isEmpty())
+        {
+            ::optimizeMesh(positions, normals, texCoords, indices);
+            if (::writeMeshFile(path, positions, normals, texCoords, indices))
+                file.open(path);
+        }
+    }
+
+    int mesh;
+    if (file.isOpen())
+    {
+        mesh = this->_scene.addMesh(file);
+    }
+    else
+    {
+        unsigned int vertexArray = Cg::createVertexArrayObject(positions, normals, texCoords, indices);
+        CG_ASSERT_GLCHECK();
+        mesh = this->_scene.addMesh(vertexArray, indices.size(), positions);
+    }
+    this->_meshLoadTime = timer.nsecsElapsed() * 1e-6;
+    return mesh;
+}
+
+//  the plane, and the models in a grid of k x k cells on it, scaled by
+//  1/k so that the grid covers the plane as a single model does
+void SSAORenderer::setupSceneInstances()
+{
+    Scene& scene = this->_scene;
+    scene.clearInstances();
+
+    QMatrix4x4 plane;
+    plane.scale(1.5f);
+    plane.rotate(-90.0f, 1.0f, 0.0f, 0.0f);
+    scene.addInstance(this->_mesh_plane, plane, QVector3D(0.8f, 0.8f, 1.0f), false);
+
+    const int k = int(std::ceil(std::sqrt(float(this->_sceneObjects))));
+    const float cell = 3.0f / k, scale = 1.0f / k;
+    this->_firstModelInstance = scene.instanceCount();
+    this->_modelPlacements.clear();
+    for (int i = 0; i < this->_sceneObjects; i++)
+    {
+        QMatrix4x4 placement;
+        placement.translate(-1.5f + cell * (i % k + 0.5f), 0.5f * scale, -1.5f + cell * (i / k + 0.5f));
+        placement.scale(scale);
+        this->_modelPlacements.append(placement);
+        placement.rotate(this->_modelAngle, 0.0f, 1.0f, 0.0f);
+        scene.addInstance(this->_mesh_model, placement, QVector3D(1.0f, 0.0f, 0.4f), true);
+    }
+}
+
+void SSAORenderer::setSceneObjects(int count)
+{
+    count = std::min(std::max(count, 1), 65536);
+    if (count == this->_sceneObjects)
+        return;
+    this->_sceneObjects = count;
+
+    //  nothing allocated yet, initialize() will pick up the count
+    if (this->_width == 0)
+        return;
+    this->setupSceneInstances();
+}
+
+//  declare all screen-size dependent targets with their lifetimes, let the
+//  pool assign textures and attach them to FBOs
+void SSAORenderer::setupTargets()
+{
+    this->releaseFramebuffers();
+    RenderTargetPool& pool = this->_targetPool;
+    pool.begin();
+
+    //  the frame ends with the lighting pass; targets that are read by a
+    //  later frame must not share their texture with anything
+    const int lighting = Step_Lighting;
+    const int aoEnd = this->_aoDivisor > 1 ? Step_AOUpsample : Step_Lighting;
+
+    // - g-buffer: position (not needed if positions are reconstructed
+    //   from depth), normal, color, shadow coords (not needed in the
+    //   compact layout or with cascades), motion vectors (only needed for temporal ssao)
+    //   and depth
+    const bool compact = this->_compactGBuffer;
+    const GLenum normalFormat = compact ? GL_RG16 : GL_RGB16F;
+    RenderTargetPool::Format screen = { this->_width, this->_height, GL_RGB16F, 1, GL_NEAREST };
+    RenderTargetPool::Format normals = screen, albedo = screen, depth = screen;
+    normals.internalFormat = normalFormat;
+    albedo.internalFormat = GL_RGBA8;
+    //  with a stencil to reject the background in the ssao pass
+    depth.internalFormat = this->rejectsBackground() ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+    int position = this->_reconstructPosition ? -1 : pool.declare(screen, Step_Geometry, lighting);
+    int normal = pool.declare(normals, Step_Geometry, lighting);
+    int color = pool.declare(albedo, Step_Geometry, lighting);
+    int shadow = this->storesShadowCoords() ? pool.declare(screen, Step_Geometry, lighting) : -1;
+    int motion = this->_temporal ? pool.declare(screen, Step_Geometry, Step_Temporal) : -1;
+    int depthBuffer = pool.declare(depth, Step_Geometry, lighting);
+
+    //  downsampled view depth and normals, one level per halving. only the
+    //  level at ssao resolution is read after the downsampling.
+    int pyramid[AO_PYRAMID_LEVELS][2];
+    GLsizei levelWidth = this->_width, levelHeight = this->_height;
+    for (int level = 0; level < AO_PYRAMID_LEVELS; level++)
+    {
+        pyramid[level][0] = pyramid[level][1] = -1;
+        if ((2 << level) > this->_aoDivisor)
+            continue;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+        int lastUse = ((2 << level) == this->_aoDivisor) ? aoEnd : Step_AODownsample;
+        RenderTargetPool::Format viewZ = { levelWidth, levelHeight, GL_R32F, 1, GL_NEAREST };
+        RenderTargetPool::Format levelNormal = { levelWidth, levelHeight, normalFormat, 1, GL_NEAREST };
+        pyramid[level][0] = pool.declare(viewZ, Step_AODownsample, lastUse);
+        pyramid[level][1] = pool.declare(levelNormal, Step_AODownsample, lastUse);
+    }
+    this->_aoWidth = levelWidth;
+    this->_aoHeight = levelHeight;
+
+    //  ssao, blur intermediate and blur result. the raw ssao is dead once
+    //  it has been blurred horizontally (or accumulated), so it shares its
+    //  texture with the blur result (or the intermediate one).
+    const GLenum aoFormat = compact ? GL_R8 : GL_R16F;
+    RenderTargetPool::Format ao = { this->_aoWidth, this->_aoHeight, aoFormat, 1, GL_NEAREST };
+    int ssao = pool.declare(ao, Step_SSAO, this->_temporal ? Step_Temporal : Step_BlurHorizontal);
+    int blurTmp = pool.declare(ao, Step_BlurHorizontal, Step_BlurVertical);
+    int blur = pool.declare(ao, Step_BlurVertical, aoEnd);
+    int compute = this->_computeSSAO ? pool.declare(ao, Step_SSAO, aoEnd) : -1;
+
+    //  taps per pixel of the adaptive ssao, with mipmaps down to 1x1
+    int samples = -1;
+    if (this->_adaptiveAO)
+    {
+        int levels = 1;
+        while ((std::max(this->_aoWidth, this->_aoHeight) >> levels) > 0)
+            levels++;
+        this->_ssaoSamplesLevels = levels;
+        RenderTargetPool::Format samplesFormat = { this->_aoWidth, this->_aoHeight, GL_R16F, levels, GL_NEAREST };
+        samples = pool.declare(samplesFormat, Step_SSAO, Step_SSAO);
+    }
+
+    //  accumulated ssao of this and the previous frame (ao and view z)
+    RenderTargetPool::Format history = { this->_aoWidth, this->_aoHeight, GL_RG16F, 1, GL_LINEAR };
+    int historyTarget[2] = { -1, -1 };
+    if (this->_temporal)
+        for (int i = 0; i < 2; i++)
+            historyTarget[i] = pool.declare(history, Step_Geometry, Step_Persistent);
+
+    //  min/max depth pyramid, down to HIZ_MAX_LEVELS levels or a single
+    //  texel, whichever comes first
+    this->_hizLevels = 0;
+    int hiz = -1;
+    if (this->_hiz)
+    {
+        int levels = 1;
+        while (levels < HIZ_MAX_LEVELS && (std::max(this->_aoWidth, this->_aoHeight) >> levels) > 0)
+            levels++;
+        this->_hizLevels = levels;
+        RenderTargetPool::Format hizFormat = { this->_aoWidth, this->_aoHeight, GL_RG32F, levels, GL_NEAREST };
+        hiz = pool.declare(hizFormat, Step_HiZ, Step_SSAO);
+    }
+
+    //  full resolution target of the upsampling
+    RenderTargetPool::Format full = { this->_width, this->_height, aoFormat, 1, GL_NEAREST };
+    int upsampled = this->_aoDivisor > 1 ? pool.declare(full, Step_AOUpsample, lighting) : -1;
+
+    //  sum of the point and spot lights
+    RenderTargetPool::Format lightFormat = { this->_width, this->_height, GL_RGBA16F, 1, GL_NEAREST };
+    int localLight = this->_localLights > 0 ? pool.declare(lightFormat, Step_Lights, lighting) : -1;
+
+    pool.allocate();
+
+    //  attach g-buffer as FBO
+    this->_gBuffer.position = pool.texture(position);
+    this->_gBuffer.normal = pool.texture(normal);
+    this->_gBuffer.albedo = pool.texture(color);
+    this->_gBuffer.shadow = pool.texture(shadow);
+    this->_gBuffer.motion = pool.texture(motion);
+    this->_gBuffer.depth = pool.texture(depthBuffer);
+    glGenFramebuffers(1, &this->_fbo_geom);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->_fbo_geom);
+    unsigned int attachments[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+    if (this->_reconstructPosition)
+        attachments[0] = GL_NONE;
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[0], GL_TEXTURE_2D, this->_gBuffer.position, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[1], GL_TEXTURE_2D, this->_gBuffer.normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[2], GL_TEXTURE_2D, this->_gBuffer.albedo, 0);
+    if (!this->storesShadowCoords())
+        attachments[3] = GL_NONE;
+    else
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[3], GL_TEXTURE_2D, this->_gBuffer.shadow, 0);
+    if (this->_temporal)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[4], GL_TEXTURE_2D, this->_gBuffer.motion, 0);
+    glDrawBuffers(this->_temporal ? 5 : 4, attachments);
+    //  also, attach depth texture to this fbo.
+    glFramebufferTexture2D(GL_FRAMEBUFFER, this->rejectsBackground() ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+        GL_TEXTURE_2D, this->_gBuffer.depth, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    CG_ASSERT_GLCHECK();
+
+    for (int level = 0; level < AO_PYRAMID_LEVELS; level++)
+    {
+        AOLevel& l = this->_aoPyramid[level];
+        l.viewZ = pool.texture(pyramid[level][0]);
+        l.normal = pool.texture(pyramid[level][1]);
+        l.fbo = 0;
+        if (l.viewZ == 0)
+            continue;
+        unsigned int targets[2] = { l.viewZ, l.normal };
+        ::createFramebuffer(2, targets, l.fbo);
+    }
+
+    this->_tex_ssao = pool.texture(ssao);
+    this->_tex_ssao_blur_tmp = pool.texture(blurTmp);
+    this->_tex_ssao_blur = pool.texture(blur);
+    this->_tex_ssao_samples = pool.texture(samples);
+    unsigned int ssaoTargets[2] = { this->_tex_ssao, this->_tex_ssao_samples };
+    ::createFramebuffer(this->_tex_ssao_samples != 0 ? 2 : 1, ssaoTargets, this->_fbo_ssao);
+    if (this->rejectsBackground())
+    {
+        //  only tested, never written
+        glBindFramebuffer(GL_FRAMEBUFFER, this->_fbo_ssao);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_TEXTURE_2D, this->_gBuffer.depth, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        CG_ASSERT_GLCHECK();
+    }
+    ::createFramebuffer(1, &this->_tex_ssao_blur_tmp, this->_fbo_ssao_blur_tmp);
+    ::createFramebuffer(1, &this->_tex_ssao_blur, this->_fbo_ssao_blur);
+    this->_tex_ssao_compute = pool.texture(compute);
+
+    for (int i = 0; i < 2; i++)
+    {
+        this->_tex_ssao_history[i] = pool.texture(historyTarget[i]);
+        this->_fbo_ssao_history[i] = 0;
+        if (this->_tex_ssao_history[i] != 0)
+            ::createFramebuffer(1, &this->_tex_ssao_history[i], this->_fbo_ssao_history[i]);
+    }
+    this->_historyValid = false;
+
+    this->_tex_hiz = pool.texture(hiz);
+    for (int level = 0; level < HIZ_MAX_LEVELS; level++)
+        this->_fbo_hiz[level] = 0;
+    if (this->_hizLevels > 0)
+    {
+        glGenFramebuffers(this->_hizLevels, this->_fbo_hiz);
+        for (int level = 0; level < this->_hizLevels; level++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, this->_fbo_hiz[level]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->_tex_hiz, level);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        CG_ASSERT_GLCHECK();
+    }
+
+    this->_tex_ssao_full = pool.texture(upsampled);
+    this->_fbo_ssao_full = 0;
+    if (this->_tex_ssao_full != 0)
+        ::createFramebuffer(1, &this->_tex_ssao_full, this->_fbo_ssao_full);
+
+    this->_tex_local_light = pool.texture(localLight);
+}
+
+//  delete the FBOs of the targets (the textures belong to the pool)
+void SSAORenderer::releaseFramebuffers()
+{
+    unsigned int fbos[5] = { this->_fbo_geom, this->_fbo_ssao, this->_fbo_ssao_blur,
+        this->_fbo_ssao_blur_tmp, this->_fbo_ssao_full };
+    glDeleteFramebuffers(5, fbos);
+    for (int level = 0; level < AO_PYRAMID_LEVELS; level++)
+        glDeleteFramebuffers(1, &this->_aoPyramid[level].fbo);
+    glDeleteFramebuffers(HIZ_MAX_LEVELS, this->_fbo_hiz);
+    glDeleteFramebuffers(2, this->_fbo_ssao_history);
+    this->_fbo_geom = this->_fbo_ssao = this->_fbo_ssao_blur = 0;
+    this->_fbo_ssao_blur_tmp = this->_fbo_ssao_full = 0;
+    for (int level = 0; level < AO_PYRAMID_LEVELS; level++)
+        this->_aoPyramid[level].fbo = 0;
+    for (int level = 0; level < HIZ_MAX_LEVELS; level++)
+        this->_fbo_hiz[level] = 0;
+    this->_fbo_ssao_history[0] = this->_fbo_ssao_history[1] = 0;
+    CG_ASSERT_GLCHECK();
+}
+
+//  (re)build all programs that depend on the g-buffer layout or ao resolution
+void SSAORenderer::setupPrograms()
+{
+    QString defines, normalDefines;
+    if (this->_compactGBuffer)
+        normalDefines = "#define COMPACT_GBUFFER\n";
+    if (this->_reconstructPosition)
+        defines.append("#define RECONSTRUCT_POSITION\n");
+    defines.append(normalDefines);
+    QString aoDefines = this->_aoDivisor > 1 ? "#define GBUFFER_VIEW_Z\n" + normalDefines : defines;
+
+    // Set up a pipeline for g-buffer pass
+    QString geomDefines = defines;
+    if (this->_temporal)
+        geomDefines.append("#define TEMPORAL\n");
+    if (!this->storesShadowCoords())
+        geomDefines.append("#define SHADOW_FROM_POSITION\n");
+    ::createShaderProgram(this->_prg_geom, "vs_geom.glsl", "fs_geom.glsl", 0, geomDefines);
+
+    //  set up pipelines for the depth pyramid: the first level reads
+    //  the same view depth as ssao, every further one its predecessor
+    if (this->_hiz)
+    {
+        ::createShaderProgram(this->_prg_hiz_gbuffer,
+            "vs_deferred.glsl", "fs_hiz.glsl",
+            0, aoDefines + "#define FROM_GBUFFER\n");
+        this->_prg_hiz_gbuffer.bind();
+        this->_prg_hiz_gbuffer.setUniformValue("g_position", 0);
+        this->_prg_hiz_gbuffer.setUniformValue("g_depth", 0);
+        this->_prg_hiz_gbuffer.setUniformValue("g_view_z", 0);
+
+        ::createShaderProgram(this->_prg_hiz,
+            "vs_deferred.glsl", "fs_hiz.glsl", 0);
+        this->_prg_hiz.bind();
+        this->_prg_hiz.setUniformValue("source_hiz", 0);
+    }
+
+    //  set up a pipeline for temporal accumulation
+    if (this->_temporal)
+    {
+        ::createShaderProgram(this->_prg_ssao_temporal,
+            "vs_deferred.glsl",
+            "fs_ssao_temporal.glsl",
+            0, aoDefines);
+        this->_prg_ssao_temporal.bind();
+        this->_prg_ssao_temporal.setUniformValue("ssao_texture", 0);
+        this->_prg_ssao_temporal.setUniformValue("history_texture", 1);
+        this->_prg_ssao_temporal.setUniformValue("g_motion", 2);
+        this->_prg_ssao_temporal.setUniformValue("g_position", 3);
+        this->_prg_ssao_temporal.setUniformValue("g_depth", 3);
+        this->_prg_ssao_temporal.setUniformValue("g_view_z", 3);
+    }
+
+    //  set up pipelines for the depth/normal pyramid and the upsampling
+    if (this->_aoDivisor > 1)
+    {
+        ::createShaderProgram(this->_prg_ao_downsample_gbuffer,
+            "vs_deferred.glsl", "fs_ao_downsample.glsl",
+            0, defines + "#define FROM_GBUFFER\n");
+        this->_prg_ao_downsample_gbuffer.bind();
+        this->_prg_ao_downsample_gbuffer.setUniformValue("g_position", 0);
+        this->_prg_ao_downsample_gbuffer.setUniformValue("g_depth", 0);
+        this->_prg_ao_downsample_gbuffer.setUniformValue("g_normal", 1);
+
+        ::createShaderProgram(this->_prg_ao_downsample,
+            "vs_deferred.glsl", "fs_ao_downsample.glsl", 0, normalDefines);
+        this->_prg_ao_downsample.bind();
+        this->_prg_ao_downsample.setUniformValue("source_view_z", 0);
+        this->_prg_ao_downsample.setUniformValue("source_normal", 1);
+
+        ::createShaderProgram(this->_prg_ao_upsample,
+            "vs_deferred.glsl", "fs_ssao_upsample.glsl", 0, defines);
+        this->_prg_ao_upsample.bind();
+        this->_prg_ao_upsample.setUniformValue("g_position", 0);
+        this->_prg_ao_upsample.setUniformValue("g_depth", 0);
+        this->_prg_ao_upsample.setUniformValue("g_normal", 1);
+        this->_prg_ao_upsample.setUniformValue("ssao_texture", 2);
+        this->_prg_ao_upsample.setUniformValue("low_view_z", 3);
+        this->_prg_ao_upsample.setUniformValue("low_normal", 4);
+    }
+
+    //  pick the variants with compile-time sample counts (ssao, blur and
+    //  lighting), and have those of the other tiers ready as well
+    this->precompileQualityTiers();
+    this->selectVariants();
+}
+
+//  fetch a program variant, compiling it on first use
+QOpenGLShaderProgram* SSAORenderer::programVariant(const char* vs, const char* fs,
+    const QString& defines)
+{
+    QString key = QString(vs) + "|" + fs + "|" + defines;
+    QOpenGLShaderProgram* program = this->_programVariants.value(key, NULL);
+    if (!program)
+    {
+        program = new QOpenGLShaderProgram();
+        ::createShaderProgram(*program, vs, fs, 0, defines);
+        this->_programVariants.insert(key, program);
+    }
+    return program;
+}
+
+QOpenGLShaderProgram* SSAORenderer::computeVariant(const char* cs, const QString& defines)
+{
+    QString key = QString(cs) + "|" + defines;
+    QOpenGLShaderProgram* program = this->_programVariants.value(key, NULL);
+    if (!program)
+    {
+        program = new QOpenGLShaderProgram();
+        ::createComputeProgram(*program, cs, defines);
+        this->_programVariants.insert(key, program);
+    }
+    return program;
+}
+
+//  the ao technique, with its sample counts compiled in.
+//  at reduced resolution it reads the downsampled view depth instead
+QOpenGLShaderProgram* SSAORenderer::ssaoVariant(const QualitySettings& settings)
+{
+    static const char* aoShaders[AOTechniqueCount] = { "fs_ssao.glsl", "fs_hbao.glsl", "fs_gtao.glsl" };
+
+    QString defines;
+    if (this->_aoDivisor > 1)
+        defines.append("#define GBUFFER_VIEW_Z\n");
+    else if (this->_reconstructPosition)
+        defines.append("#define RECONSTRUCT_POSITION\n");
+    if (this->_compactGBuffer)
+        defines.append("#define COMPACT_GBUFFER\n");
+    if (this->_hiz)
+        defines.append("#define HIZ\n");
+    switch (this->_aoTechnique)
+    {
+    case AO_Hemisphere:
+        if (this->_adaptiveAO)
+            defines.append("#define ADAPTIVE_SAMPLES\n");
+        //  temporal mode spreads the kernel over frames
+        defines.append(QString("#define SAMPLE_COUNT %1\n")
+            .arg(this->_temporal ? this->_temporalSamples : settings.hemisphereSamples));
+        break;
+    case AO_HBAO:
+        defines.append(QString("#define DIRECTION_COUNT %1\n#define STEP_COUNT %2\n")
+            .arg(settings.hbaoDirections).arg(settings.hbaoSteps));
+        break;
+    case AO_GTAO:
+        defines.append(QString("#define SLICE_COUNT %1\n#define STEP_COUNT %2\n")
+            .arg(settings.gtaoSlices).arg(settings.gtaoSteps));
+        break;
+    default:
+        break;
+    }
+
+    QOpenGLShaderProgram* program = this->programVariant("vs_deferred.glsl",
+        aoShaders[this->_aoTechnique], defines);
+    //  set sampler location for all input textures
+    //  (g_position, g_depth and g_view_z share a unit, only one of them exists)
+    program->bind();
+    program->setUniformValue("g_position", 0);
+    program->setUniformValue("g_depth", 0);
+    program->setUniformValue("g_view_z", 0);
+    program->setUniformValue("g_normal", 1);
+    program->setUniformValue("noise_texture", 2);
+    program->setUniformValue("hiz_texture", 3);
+    return program;
+}
+
+//  the separable ssao blur, which reads depth and normals at ssao
+//  resolution as well
+QOpenGLShaderProgram* SSAORenderer::blurVariant(int blurRadius)
+{
+    QString defines = QString("#define BLUR_RADIUS %1\n").arg(blurRadius);
+    if (this->_aoDivisor > 1)
+        defines.append("#define GBUFFER_VIEW_Z\n");
+    else if (this->_reconstructPosition)
+        defines.append("#define RECONSTRUCT_POSITION\n");
+    if (this->_compactGBuffer)
+        defines.append("#define COMPACT_GBUFFER\n");
+
+    QOpenGLShaderProgram* program = this->programVariant("vs_deferred.glsl",
+        "fs_ssao_blur.glsl", defines);
+    //  set sampler location for all input textures
+    program->bind();
+    program->setUniformValue("ssao_texture", 0);
+    program->setUniformValue("g_position", 1);
+    program->setUniformValue("g_depth", 1);
+    program->setUniformValue("g_view_z", 1);
+    program->setUniformValue("g_normal", 2);
+    return program;
+}
+
+//  the fused compute ssao + blur. its blur keeps the border in shared
+//  memory, which limits the radius.
+QOpenGLShaderProgram* SSAORenderer::computeSSAOVariant(const QualitySettings& settings)
+{
+    QString defines = QString("#define SAMPLE_COUNT %1\n#define BLUR_RADIUS %2\n")
+        .arg(settings.hemisphereSamples)
+        .arg(std::min(settings.blurRadius, COMPUTE_MAX_BLUR_RADIUS));
+    if (this->_aoDivisor > 1)
+        defines.append("#define GBUFFER_VIEW_Z\n");
+    else if (this->_reconstructPosition)
+        defines.append("#define RECONSTRUCT_POSITION\n");
+    if (this->_compactGBuffer)
+        defines.append("#define COMPACT_GBUFFER\n");
+    if (this->_hiz)
+        defines.append("#define HIZ\n");
+
+    QOpenGLShaderProgram* program = this->computeVariant("cs_ssao.glsl", defines);
+    program->bind();
+    program->setUniformValue("g_position", 0);
+    program->setUniformValue("g_depth", 0);
+    program->setUniformValue("g_view_z", 0);
+    program->setUniformValue("g_normal", 1);
+    program->setUniformValue("noise_texture", 2);
+    program->setUniformValue("hiz_texture", 3);
+    return program;
+}
+
+//  the lighting pass, with the pcf kernel size compiled in
+QOpenGLShaderProgram* SSAORenderer::lightingVariant(int pcfSize)
+{
+    QString defines = QString("#define PCF_SIZE %1\n#define SHADOW_CASCADES %2\n")
+        .arg(pcfSize).arg(this->_shadowCascades);
+    if (!this->storesShadowCoords())
+        defines.append("#define SHADOW_FROM_POSITION\n");
+    static const char* filterDefines[ShadowFilterCount] = {
+        "", "#define SHADOW_FILTER_HARDWARE\n", "#define SHADOW_FILTER_OPTIMIZED\n", "#define SHADOW_FILTER_POISSON\n"
+    };
+    defines.append(filterDefines[this->_shadowFilter]);
+    if (this->_reconstructPosition)
+        defines.append("#define RECONSTRUCT_POSITION\n");
+    if (this->_compactGBuffer)
+        defines.append("#define COMPACT_GBUFFER\n");
+    if (!this->_aoEnabled)
+        defines.append("#define NO_AO\n");
+    if (!this->_shadowsEnabled)
+        defines.append("#define NO_SHADOWS\n");
+    if (this->_localLights > 0)
+        defines.append("#define LOCAL_LIGHTS\n");
+
+    QOpenGLShaderProgram* program = this->programVariant("vs_deferred.glsl",
+        "fs_lighting.glsl", defines);
+    //  set sampler location for all input textures
+    program->bind();
+    program->setUniformValue("g_position", 0);
+    program->setUniformValue("g_depth", 0);
+    program->setUniformValue("g_normal", 1);
+    program->setUniformValue("g_albedo", 2);
+    program->setUniformValue("g_shadow", 3);
+    program->setUniformValue("ssao_texture", 4);
+    program->setUniformValue("shadow_map", 5);
+    program->setUniformValue("local_light_texture", 6);
+    return program;
+}
+
+//  the point and spot lights, culled per tile or not at all
+QOpenGLShaderProgram* SSAORenderer::lightsVariant()
+{
+    QString defines;
+    if (this->_lightCulling == LightCulling_Tiled)
+        defines.append("#define TILED_LIGHTS\n");
+    if (this->_reconstructPosition)
+        defines.append("#define RECONSTRUCT_POSITION\n");
+    if (this->_compactGBuffer)
+        defines.append("#define COMPACT_GBUFFER\n");
+
+    QOpenGLShaderProgram* program = this->computeVariant("cs_lights.glsl", defines);
+    program->bind();
+    program->setUniformValue("g_position", 0);
+    program->setUniformValue("g_depth", 0);
+    program->setUniformValue("g_normal", 1);
+    program->setUniformValue("depth_buffer", 2);
+    return program;
+}
+
+SSAORenderer::QualitySettings SSAORenderer::currentQualitySettings() const
+{
+    QualitySettings settings;
+    settings.hemisphereSamples = this->_hemisphere.samples;
+    settings.hbaoDirections = this->_hbao.directions;
+    settings.hbaoSteps = this->_hbao.steps;
+    settings.gtaoSlices = this->_gtao.slices;
+    settings.gtaoSteps = this->_gtao.steps;
+    settings.blurRadius = this->_blurRadius;
+    settings.pcfSize = this->_pcfSize;
+    return settings;
+}
+
+//  select the variants for the current settings
+void SSAORenderer::selectVariants()
+{
+    QualitySettings settings = this->currentQualitySettings();
+    this->_prg_ssao = this->ssaoVariant(settings);
+    this->_prg_ssao_blur = this->blurVariant(settings.blurRadius);
+    this->_prg_main = this->lightingVariant(settings.pcfSize);
+    this->_prg_ssao_compute = this->_computeSSAO ? this->computeSSAOVariant(settings) : NULL;
+    this->_prg_lights = this->_localLights > 0 ? this->lightsVariant() : NULL;
+}
+
+//  compile the variants of all tiers for the current modes
+void SSAORenderer::precompileQualityTiers()
+{
+    for (int quality = 0; quality < QualityCount; quality++)
+    {
+        QualitySettings settings = qualitySettings(Quality(quality));
+        this->ssaoVariant(settings);
+        this->blurVariant(settings.blurRadius);
+        this->lightingVariant(settings.pcfSize);
+        if (this->_computeSSAO)
+            this->computeSSAOVariant(settings);
+    }
+}
+
+//  setup SSAO pipeline, kernel and noise texture
+void SSAORenderer::setupSSAOPass()
+{
+    /////////////////////////////////////////
+    //  Setup G-Buffer and SSAO targets
+    /////////////////////////////////////////
+    this->setupTargets();
+
+    //  setup SSAO kernel and noise texture
+    this->setupSSAOKernel();
+}
+
+//  setup SSAO kernel and noise texture
+void SSAORenderer::setupSSAOKernel()
+{
+    //  same kernel and noise as the CPU reference implementation
+    float kernel[SSAO_KERNEL_SIZE * 3], noise[SSAO_NOISE_SIZE * SSAO_NOISE_SIZE * 3];
+    ::generateSSAOKernel(kernel, noise);
+
+    //  the kernel never changes: an immutable uniform buffer, with the
+    //  points padded to vec4 as std140 lays out arrays
+    float points[SSAO_KERNEL_SIZE * 4];
+    for (int i = 0; i < SSAO_KERNEL_SIZE; ++i)
+    {
+        std::memcpy(points + i * 4, kernel + i * 3, 3 * sizeof(float));
+        points[i * 4 + 3] = 0.0f;
+    }
+    glDeleteBuffers(1, &this->_ubo_ssao_kernel);
+    glCreateBuffers(1, &this->_ubo_ssao_kernel);
+    glNamedBufferStorage(this->_ubo_ssao_kernel, sizeof(points), points, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SSAO_KERNEL_BINDING, this->_ubo_ssao_kernel);
+    CG_ASSERT_GLCHECK();
+
+    this->_ssaoNoise.clear();
+    for (int i = 0; i < SSAO_NOISE_SIZE * SSAO_NOISE_SIZE; i++)
+        this->_ssaoNoise.push_back(QVector3D(noise[i * 3], noise[i * 3 + 1], noise[i * 3 + 2]));
+    ::createTexture(SSAO_NOISE_SIZE, SSAO_NOISE_SIZE,
+        GL_RGB32F, GL_RGB, GL_FLOAT,
+        GL_NEAREST, GL_REPEAT,
+        this->_ssaoNoise.data(), this->_tex_noise);
+}
+
+void SSAORenderer::setupLocalLights()
+{
+    glDeleteBuffers(1, &this->_ssbo_lights);
+    this->_ssbo_lights = 0;
+    if (this->_localLights == 0)
+        return;
+
+    //  a fixed seed, so that every run sees the same lights. a constant
+    //  radius keeps the lights per tile growing with the count, and the
+    //  intensity falls with it so that many lights do not saturate.
+    std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+    std::default_random_engine generator;
+    float intensity = 0.02f * std::sqrt(64.0f / std::max(this->_localLights, 64));
+    QVector<LocalLight> lights(this->_localLights);
+    for (int i = 0; i < this->_localLights; i++)
+    {
+        LocalLight& light = lights[i];
+        light.position[0] = (randomFloats(generator) * 2.0f - 1.0f) * LOCAL_LIGHT_EXTENT;
+        light.position[1] = 0.05f + randomFloats(generator) * 0.45f;
+        light.position[2] = (randomFloats(generator) * 2.0f - 1.0f) * LOCAL_LIGHT_EXTENT;
+        light.radius = 0.2f + randomFloats(generator) * 0.3f;
+        for (int c = 0; c < 3; c++)
+            light.color[c] = (0.25f + randomFloats(generator) * 0.75f) * intensity;
+
+        //  every fourth light is a spot light pointing down
+        bool spot = i % 4 == 3;
+        light.direction[0] = 0.0f;
+        light.direction[1] = -1.0f;
+        light.direction[2] = 0.0f;
+        light.cosInner = spot ? 0.9f : 1.0f;
+        light.cosOuter = spot ? 0.8f : -1.0f;
+    }
+
+    glCreateBuffers(1, &this->_ssbo_lights);
+    glNamedBufferStorage(this->_ssbo_lights, lights.size() * sizeof(LocalLight), lights.constData(), 0);
+    CG_ASSERT_GLCHECK();
+}
+
+//  setup shadow map pipeline
+void SSAORenderer::setupShadowPass()
+{
+    this->setupShadowMaps();
+
+    //  set up a pipeline for shadow map
+    ::createShaderProgram(this->_prg_shadow, "                                  \
+            layout(location = 0) in vec4 position;                             \
+            layout(location = 4) in mat4 model_matrix;                          \
+                                                                                \
+            uniform mat4 light_matrix;                                          \
+                                                                                \
+            void main()                                                         \
+            {                                                                   \
+                gl_Position = light_matrix * (model_matrix * position);         \
+            }                                                                   \
+        ",
+        "                                                                       \
+            void main() {}                                                      \
+        ",
+        3);
+}
+
+//  depth maps: the one read by the lighting, and the cached one of the
+//  static casters, both with a layer per cascade
+void SSAORenderer::setupShadowMaps()
+{
+    this->releaseShadowMaps();
+    unsigned int* textures[2] = { &this->_tex_depth, &this->_tex_depth_static };
+    unsigned int* fbos[2] = { this->_fbo_depth, this->_fbo_depth_static };
+    for (int i = 0; i < 2; i++)
+    {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, *textures[i]);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F,
+            this->_shadowMapSize, this->_shadowMapSize, this->_shadowCascades);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        CG_ASSERT_GLCHECK();
+
+        // attach each layer as the depth buffer of its own FBO
+        glGenFramebuffers(this->_shadowCascades, fbos[i]);
+        for (int c = 0; c < this->_shadowCascades; c++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbos[i][c]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, *textures[i], 0, c);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        CG_ASSERT_GLCHECK();
+    }
+    this->_shadowStaticValid = false;
+    this->setupShadowSampling();
+}
+
+void SSAORenderer::setupShadowSampling()
+{
+    //  the static map is only ever copied, so it keeps nearest sampling
+    bool compare = this->_shadowFilter != Shadow_PCF;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->_tex_depth);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, compare ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    CG_ASSERT_GLCHECK();
+}
+
+void SSAORenderer::releaseShadowMaps()
+{
+    glDeleteTextures(1, &this->_tex_depth);
+    glDeleteTextures(1, &this->_tex_depth_static);
+    glDeleteFramebuffers(SHADOW_MAX_CASCADES, this->_fbo_depth);
+    glDeleteFramebuffers(SHADOW_MAX_CASCADES, this->_fbo_depth_static);
+    this->_tex_depth = this->_tex_depth_static = 0;
+    for (int c = 0; c < SHADOW_MAX_CASCADES; c++)
+        this->_fbo_depth[c] = this->_fbo_depth_static[c] = 0;
+}
+
+void SSAORenderer::setShadowMapSize(int size)
+{
+    size = std::min(std::max(size, 64), 8192);
+    if (size == this->_shadowMapSize)
+        return;
+    this->_shadowMapSize = size;
+
+    //  nothing allocated yet, initialize() will pick up the size
+    if (this->_width == 0)
+        return;
+    this->setupShadowMaps();
+}
+
+void SSAORenderer::setShadowFilter(ShadowFilter filter)
+{
+    if (filter == this->_shadowFilter || filter < 0 || filter >= ShadowFilterCount)
+        return;
+    this->_shadowFilter = filter;
+
+    //  nothing allocated yet, initialize() will pick up the filter.
+    //  the sampler type in the lighting has to match the compare mode.
+    if (this->_width == 0)
+        return;
+    this->setupShadowSampling();
+    this->selectVariants();
+}
+
+void SSAORenderer::setShadowCascades(int cascades)
+{
+    cascades = std::min(std::max(cascades, 1), int(SHADOW_MAX_CASCADES));
+    if (cascades == this->_shadowCascades)
+        return;
+    this->_shadowCascades = cascades;
+
+    //  nothing allocated yet, initialize() will pick up the cascades.
+    //  with cascades, the g-buffer stores no shadow map coordinates.
+    if (this->_width == 0)
+        return;
+    this->setupShadowMaps();
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::initialize(int width, int height)
+{
+    this->initializeOpenGLFunctions();
+    this->_width = width;
+    this->_height = height;
+    this->_ring.initialize(RING_REGION_SIZE);
+
+    // Set up buffer objects for the geometry
+    this->initializeScene();
+
+    //  turn on to enable SSAO
+    this->setupSSAOPass();
+
+    //  turn on to enable shadow
+    this->setupShadowPass();
+
+    //  point and spot lights, if any
+    this->setupLocalLights();
+
+    //  set up the programs reading the g-buffer
+    this->setupPrograms();
+}
+
+void SSAORenderer::setReconstructPosition(bool reconstruct)
+{
+    if (reconstruct == this->_reconstructPosition)
+        return;
+    this->_reconstructPosition = reconstruct;
+
+    //  nothing allocated yet, initialize() will pick up the mode
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setCompactGBuffer(bool compact)
+{
+    if (compact == this->_compactGBuffer)
+        return;
+    this->_compactGBuffer = compact;
+
+    //  nothing allocated yet, initialize() will pick up the layout
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setAODivisor(int divisor)
+{
+    divisor = divisor >= 4 ? 4 : divisor >= 2 ? 2 : 1;
+    if (divisor == this->_aoDivisor)
+        return;
+    this->_aoDivisor = divisor;
+
+    //  nothing allocated yet, initialize() will pick up the resolution
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setTemporal(bool temporal)
+{
+    if (temporal == this->_temporal)
+        return;
+    this->_temporal = temporal;
+
+    //  nothing allocated yet, initialize() will pick up the mode
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setTemporalSamples(int samples)
+{
+    //  must divide the kernel size, so that the subsets cover the kernel
+    int count = 4;
+    while (count < samples && count < 64)
+        count *= 2;
+    this->_temporalSamples = count;
+
+    //  the sample count is compiled in
+    if (this->_temporal && this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setAOTechnique(AOTechnique technique)
+{
+    if (technique == this->_aoTechnique || technique < 0 || technique >= AOTechniqueCount)
+        return;
+    this->_aoTechnique = technique;
+
+    //  nothing allocated yet, initialize() will pick up the technique
+    if (this->_width == 0)
+        return;
+    this->setupPrograms();
+}
+
+void SSAORenderer::setQuality(Quality quality)
+{
+    QualitySettings settings = qualitySettings(quality);
+    this->_quality = quality;
+    this->_hemisphere.samples = settings.hemisphereSamples;
+    this->_hbao.directions = settings.hbaoDirections;
+    this->_hbao.steps = settings.hbaoSteps;
+    this->_gtao.slices = settings.gtaoSlices;
+    this->_gtao.steps = settings.gtaoSteps;
+    this->_blurRadius = settings.blurRadius;
+    this->_pcfSize = settings.pcfSize;
+
+    //  all tiers are compiled already
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setPCFSize(int size)
+{
+    //  odd, so that the kernel is centered
+    this->_pcfSize = std::min(std::max(size, 1), 7) | 1;
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setHemisphereParameters(const HemisphereParameters& parameters)
+{
+    this->_hemisphere = parameters;
+
+    //  must divide the kernel size, like the temporal subsets
+    int count = 4;
+    while (count < parameters.samples && count < 64)
+        count *= 2;
+    this->_hemisphere.samples = count;
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setHBAOParameters(const HBAOParameters& parameters)
+{
+    this->_hbao = parameters;
+    this->_hbao.directions = std::min(std::max(parameters.directions, 1), 32);
+    this->_hbao.steps = std::min(std::max(parameters.steps, 1), 32);
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setGTAOParameters(const GTAOParameters& parameters)
+{
+    this->_gtao = parameters;
+    this->_gtao.slices = std::min(std::max(parameters.slices, 1), 16);
+    this->_gtao.steps = std::min(std::max(parameters.steps, 1), 32);
+    this->_gtao.falloffRange = std::min(std::max(parameters.falloffRange, 0.01f), 1.0f);
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setHiZ(bool hiz)
+{
+    if (hiz == this->_hiz)
+        return;
+    this->_hiz = hiz;
+
+    //  nothing allocated yet, initialize() will pick up the mode
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setAdaptiveAO(bool adaptive)
+{
+    if (adaptive == this->_adaptiveAO)
+        return;
+    this->_adaptiveAO = adaptive;
+
+    //  nothing allocated yet, initialize() will pick up the mode
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setComputeSSAO(bool compute)
+{
+    if (compute == this->_computeSSAO)
+        return;
+    this->_computeSSAO = compute;
+
+    //  nothing allocated yet, initialize() will pick up the mode
+    if (this->_width == 0)
+        return;
+    this->setupTargets();
+    this->setupPrograms();
+}
+
+void SSAORenderer::setBlurRadius(int radius)
+{
+    radius = std::min(std::max(radius, 0), 16);
+    if (radius == this->_blurRadius)
+        return;
+    this->_blurRadius = radius;
+
+    //  the radius is compiled in
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setAOEnabled(bool enabled)
+{
+    if (enabled == this->_aoEnabled)
+        return;
+    this->_aoEnabled = enabled;
+
+    //  the lighting variant reads the ao or not
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setShadowsEnabled(bool enabled)
+{
+    if (enabled == this->_shadowsEnabled)
+        return;
+    this->_shadowsEnabled = enabled;
+
+    //  the lighting variant reads the shadow map or not
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setLocalLights(int count)
+{
+    count = std::min(std::max(count, 0), MAX_LOCAL_LIGHTS);
+    if (count == this->_localLights)
+        return;
+    bool toggled = (count > 0) != (this->_localLights > 0);
+    this->_localLights = count;
+    if (this->_width == 0)
+        return;
+
+    //  the light target and the lighting variant exist only with lights
+    this->setupLocalLights();
+    if (toggled)
+    {
+        this->setupTargets();
+        this->selectVariants();
+    }
+}
+
+void SSAORenderer::setLightCulling(LightCulling culling)
+{
+    if (culling == this->_lightCulling)
+        return;
+    this->_lightCulling = culling;
+
+    //  the culling is compiled into the lights variant
+    if (this->_width != 0)
+        this->selectVariants();
+}
+
+void SSAORenderer::setLightAzimuthAngle(int degrees)
+{
+    //  x = rcos(-), z = rsin(-)
+    this->_lightAzimuthAngle = degrees % 360;
+    float angleInRadian = this->_lightAzimuthAngle * M_PI / 180.0f;
+    this->_lightDir = -QVector3D(cosf(angleInRadian), 1.0f, sinf(angleInRadian)).normalized();
+}
+
+void SSAORenderer::setTimingEnabled(bool enabled)
+{
+    if (enabled && this->_timerQueries[0][0] == 0)
+        glGenQueries(2 * PassCount, &this->_timerQueries[0][0]);
+    for (int i = 0; i < PassCount; i++)
+        this->_timerIssued[0][i] = this->_timerIssued[1][i] = false;
+    this->_ssaoSamplesIssued[0] = this->_ssaoSamplesIssued[1] = false;
+    this->_meanAOSamples = -1.0f;
+    this->_lightOverflowIssued[0] = this->_lightOverflowIssued[1] = false;
+    this->_lightOverflowTiles = -1;
+    this->_timingEnabled = enabled;
+    this->_passTimesValid = false;
+}
+
+void SSAORenderer::beginPass(Pass pass)
+{
+    if (!this->_timingEnabled)
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, this->_timerQueries[this->_timerFrame & 1][pass]);
+}
+
+void SSAORenderer::endPass(Pass pass)
+{
+    if (!this->_timingEnabled)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    this->_timerIssued[this->_timerFrame & 1][pass] = true;
+}
+
+//  collect the timer results of the previous frame
+void SSAORenderer::collectPassTimes()
+{
+    if (!this->_timingEnabled)
+        return;
+
+    //  the set recorded in the previous frame is the other one
+    //  passes that were skipped in that frame report -1
+    unsigned int set = (this->_timerFrame + 1) & 1;
+    bool complete = false;
+    for (int i = 0; i < PassCount; i++)
+    {
+        if (!this->_timerIssued[set][i])
+        {
+            this->_passTimes[i] = -1.0;
+            continue;
+        }
+        complete = true;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(this->_timerQueries[set][i], GL_QUERY_RESULT, &elapsed);
+        this->_passTimes[i] = elapsed * 1e-6;
+        this->_timerIssued[set][i] = false;
+    }
+    this->_passTimesValid = complete;
+
+    //  the mean ssao taps of the same frame, done with it
+    this->_meanAOSamples = -1.0f;
+    if (this->_ssaoSamplesIssued[set])
+    {
+        glGetNamedBufferSubData(this->_buf_ssao_samples, set * sizeof(float), sizeof(float),
+            &this->_meanAOSamples);
+        this->_ssaoSamplesIssued[set] = false;
+    }
+
+    //  and the tiles with too many lights
+    this->_lightOverflowTiles = -1;
+    if (this->_lightOverflowIssued[set])
+    {
+        GLuint tiles = 0;
+        glGetNamedBufferSubData(this->_buf_light_overflow[set], 0, sizeof(tiles), &tiles);
+        this->_lightOverflowTiles = int(tiles);
+        this->_lightOverflowIssued[set] = false;
+    }
+    this->_timerFrame++;
+}
+
+bool SSAORenderer::passTimes(double ms[PassCount]) const
+{
+    for (int i = 0; i < PassCount; i++)
+        ms[i] = this->_passTimes[i];
+    return this->_passTimesValid;
+}
+
+//  light space PVs of the cascades: the view depth range the scene covers
+//  is split between the cascades, and each one gets an orthographic
+//  projection around the part of the scene inside its slice of the view
+//  frustum, instead of the whole scene. the projections are snapped to
+//  whole texels, so that they do not shimmer while the camera moves.
+void SSAORenderer::fitShadowCascades(const QMatrix4x4& P, const QMatrix4x4& V)
+{
+    FrameState& frame = this->_frame;
+    QVector3D boundsMin, boundsMax;
+    this->_scene.bounds(boundsMin, boundsMax);
+    const QVector3D center = (boundsMin + boundsMax) * 0.5f;
+    QMatrix4x4 lightView;
+    lightView.lookAt(center - this->_lightDir * LIGHT_POS_DISTANCE, center, QVector3D(0.0f, 1.0f, 0.0f));
+
+    //  scene bounds in light space, and the view depth range they cover
+    QVector3D sceneMin(FLT_MAX, FLT_MAX, FLT_MAX), sceneMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    float sceneNear = FLT_MAX, sceneFar = -FLT_MAX;
+    for (int i = 0; i < 8; i++)
+    {
+        QVector3D corner((i & 1) ? boundsMax.x() : boundsMin.x(),
+            (i & 2) ? boundsMax.y() : boundsMin.y(),
+            (i & 4) ? boundsMax.z() : boundsMin.z());
+        QVector3D light = lightView.map(corner);
+        for (int k = 0; k < 3; k++)
+        {
+            sceneMin[k] = std::min(sceneMin[k], light[k]);
+            sceneMax[k] = std::max(sceneMax[k], light[k]);
+        }
+        float depth = -V.map(corner).z();
+        sceneNear = std::min(sceneNear, depth);
+        sceneFar = std::max(sceneFar, depth);
+    }
+
+    //  corners of the view frustum at the near and far plane, in view space
+    const QMatrix4x4 P_inverse = P.inverted(), V_inverse = V.inverted();
+    QVector3D nearCorners[4], farCorners[4];
+    for (int i = 0; i < 4; i++)
+    {
+        float x = (i & 1) ? 1.0f : -1.0f, y = (i & 2) ? 1.0f : -1.0f;
+        nearCorners[i] = P_inverse.map(QVector3D(x, y, -1.0f));
+        farCorners[i] = P_inverse.map(QVector3D(x, y, 1.0f));
+    }
+    const float cameraNear = -nearCorners[0].z(), cameraFar = -farCorners[0].z();
+    const float from = std::max(cameraNear, sceneNear);
+    const float to = std::max(std::min(cameraFar, sceneFar), from + 0.001f);
+
+    //  light space z covers all casters, whichever slice they are in
+    const float zNear = -sceneMax.z() - 0.05f, zFar = -sceneMin.z() + 0.05f;
+
+    //  the step the cascade sizes are rounded up to
+    const float sceneExtent = std::max(sceneMax.x() - sceneMin.x(), sceneMax.y() - sceneMin.y());
+    const float extentStep = sceneExtent / SHADOW_EXTENT_STEPS;
+
+    const int cascades = this->_shadowCascades;
+    for (int c = 0; c < cascades; c++)
+    {
+        //  split between logarithmic and uniform distribution
+        float splits[2];
+        for (int s = 0; s < 2; s++)
+        {
+            float t = float(c + s) / cascades;
+            splits[s] = SHADOW_SPLIT_LAMBDA * from * std::pow(to / from, t)
+                + (1.0f - SHADOW_SPLIT_LAMBDA) * (from + (to - from) * t);
+        }
+        frame.cascadeFar[c] = splits[1];
+
+        //  the bounding sphere of the slice of the frustum in light space.
+        //  unlike a bounding box, its size does not change as the camera turns
+        QVector3D corners[8], sliceCenter(0.0f, 0.0f, 0.0f);
+        for (int s = 0; s < 2; s++)
+        {
+            float t = (splits[s] - cameraNear) / (cameraFar - cameraNear);
+            for (int i = 0; i < 4; i++)
+            {
+                QVector3D corner = nearCorners[i] + (farCorners[i] - nearCorners[i]) * t;
+                corners[s * 4 + i] = lightView.map(V_inverse.map(corner));
+                sliceCenter += corners[s * 4 + i];
+            }
+        }
+        sliceCenter /= 8.0f;
+        float radius = 0.0f;
+        for (int i = 0; i < 8; i++)
+            radius = std::max(radius, (corners[i] - sliceCenter).length());
+
+        //  a square around it with a border of a texel for pcf, rounded up to
+        //  a fixed step and at most the scene, so that the texel size stays
+        //  the same from frame to frame and snapping to texels keeps the
+        //  shadow edges still
+        float extent = 2.0f * radius * (1.0f + 2.0f / this->_shadowMapSize);
+        extent = std::min(std::ceil(extent / extentStep) * extentStep, sceneExtent + extentStep);
+        float texel = extent / this->_shadowMapSize;
+
+        //  moved into the scene where it reaches beyond it, and snapped
+        float origin[2];
+        for (int k = 0; k < 2; k++)
+        {
+            float lo = sceneMin[k] - texel, hi = sceneMax[k] + texel - extent;
+            origin[k] = hi >= lo ? std::min(std::max(sliceCenter[k] - 0.5f * extent, lo), hi)
+                : (sceneMin[k] + sceneMax[k] - extent) * 0.5f;
+            origin[k] = std::floor(origin[k] / texel) * texel;
+        }
+        float left = origin[0], bottom = origin[1];
+
+        frame.PV_shadow[c].setToIdentity();
+        frame.PV_shadow[c].ortho(left, left + extent, bottom, bottom + extent, zNear, zFar);
+        frame.PV_shadow[c] *= lightView;
+
+        //  the depth bias is given in texels, in units of the depth range
+        frame.shadowBiasUnit[c] = texel / (zFar - zNear);
+    }
+}
+
+void SSAORenderer::render(const QMatrix4x4& P, const QMatrix4x4& V, int w, int h,
+    float deltaTime, unsigned int targetFbo)
+{
+    //  nothing to render into, e.g. while the window is minimized
+    if (w <= 0 || h <= 0)
+        return;
+
+    //  follow the size of the target; the pool only creates the
+    //  textures of the new size and deletes those of the old one
+    if (w != this->_width || h != this->_height)
+    {
+        this->_width = w;
+        this->_height = h;
+        this->setupTargets();
+    }
+
+    //  update the models' animation
+    //  our angular velocity of the model is pi/2 rad/s
+    if (this->_animated)
+        this->_modelAngle = std::fmod(this->_modelAngle + 90.0f * deltaTime, 360.0f);
+    for (int i = 0; i < this->_modelPlacements.size(); i++)
+    {
+        QMatrix4x4 model = this->_modelPlacements[i];
+        model.rotate(this->_modelAngle, 0.0f, 1.0f, 0.0f);
+        this->_scene.setModelMatrix(this->_firstModelInstance + i, model);
+    }
+
+    //  without a previous frame there is no motion
+    if (!this->_historyValid)
+    {
+        this->_prevP = P;
+        this->_prevV = V;
+        this->_scene.updateHistory();
+    }
+
+    //  view-space positions come either from the position buffer, or are
+    //  reconstructed from the depth buffer with the inverse projection
+    FrameState& frame = this->_frame;
+    frame.P = P;
+    frame.V = V;
+    frame.P_inverse = P.inverted();
+
+    //  light space PVs, fitted to the view. the cached static casters
+    //  are only valid for the same ones.
+    this->fitShadowCascades(P, V);
+    for (int c = 0; c < this->_shadowCascades; c++)
+        if (frame.PV_shadow[c] != this->_shadowPV[c])
+            this->_shadowStaticValid = false;
+    if (this->_scene.staticVersion() != this->_shadowStaticVersion)
+        this->_shadowStaticValid = false;
+    frame.shadowUpdate = !this->_shadowStaticValid
+        || this->_scene.dynamicVersion() != this->_shadowDynamicVersion;
+    this->_shadowPassSkipped = true;
+    frame.width = w;
+    frame.height = h;
+    frame.targetFbo = targetFbo;
+    frame.positionSource = this->_reconstructPosition ?
+        this->_gBuffer.depth : this->_gBuffer.position;
+
+    //  the pyramid level matching the ssao resolution, and the textures
+    //  the ao passes hand on to each other
+    frame.aoLevel = this->_aoDivisor > 1 ? &this->_aoPyramid[this->_aoDivisor / 2 - 1] : NULL;
+    bool compute = this->_computeSSAO && this->_aoTechnique == AO_Hemisphere;
+    frame.aoRaw = this->_temporal ? this->_tex_ssao_history[this->_historyIndex] : this->_tex_ssao;
+    frame.aoBlurred = compute ? this->_tex_ssao_compute : this->_tex_ssao_blur;
+    frame.aoResult = frame.aoLevel ? this->_tex_ssao_full : frame.aoBlurred;
+
+    //  write the instances and constants into the frame's region of the
+    //  ring; this only waits if the GPU is frames behind
+    this->cullScene();
+    this->_ring.beginFrame(this->_scene.uploadSize(this->_ring)
+        + this->_ring.alignedSize(sizeof(FrameConstants)));
+    this->_scene.upload(this->_ring);
+    this->uploadFrameConstants();
+
+    this->_drawCalls = 0;
+    this->buildFrameGraph();
+    this->_frameGraph.execute();
+    this->_ring.endFrame();
+
+    //  remember this frame for reprojection in the next one. without ao
+    //  nothing was accumulated, so the history is stale afterwards.
+    this->_prevP = P;
+    this->_prevV = V;
+    this->_scene.updateHistory();
+    this->_historyIndex = 1 - this->_historyIndex;
+    this->_historyValid = this->_aoEnabled;
+    this->_frameIndex++;
+
+    this->collectPassTimes();
+}
+
+//  the camera sees all instances. the shadow maps are only rendered when
+//  out of date: the cached static layers only if they are invalid, and
+//  the dynamic casters on top of them.
+void SSAORenderer::cullScene()
+{
+    FrameState& frame = this->_frame;
+    Scene& scene = this->_scene;
+    scene.beginViews();
+    frame.cameraView = scene.addView(frame.P * frame.V, Scene::AllInstances);
+    for (int c = 0; c < SHADOW_MAX_CASCADES; c++)
+        frame.shadowStaticView[c] = frame.shadowDynamicView[c] = -1;
+    if (frame.shadowUpdate && this->_shadowsEnabled)
+        for (int c = 0; c < this->_shadowCascades; c++)
+        {
+            if (!this->_shadowStaticValid)
+                frame.shadowStaticView[c] = scene.addView(frame.PV_shadow[c], Scene::StaticInstances);
+            frame.shadowDynamicView[c] = scene.addView(frame.PV_shadow[c], Scene::DynamicInstances);
+        }
+}
+
+//  the values all passes share, set once per frame instead of per program
+void SSAORenderer::uploadFrameConstants()
+{
+    const FrameState& frame = this->_frame;
+    FrameConstants constants;
+    std::memset(&constants, 0, sizeof(constants));
+    std::memcpy(constants.P, frame.P.constData(), sizeof(constants.P));
+    std::memcpy(constants.P_inverse, frame.P_inverse.constData(), sizeof(constants.P_inverse));
+    std::memcpy(constants.V, frame.V.constData(), sizeof(constants.V));
+    std::memcpy(constants.prevP, this->_prevP.constData(), sizeof(constants.prevP));
+    std::memcpy(constants.prevV, this->_prevV.constData(), sizeof(constants.prevV));
+    std::memcpy(constants.PV_shadow, frame.PV_shadow[0].constData(), sizeof(constants.PV_shadow));
+    QMatrix4x4 V_inverse = frame.V.inverted();
+    for (int c = 0; c < this->_shadowCascades; c++)
+    {
+        QMatrix4x4 viewToShadow = frame.PV_shadow[c] * V_inverse;
+        std::memcpy(constants.viewToShadow[c], viewToShadow.constData(), sizeof(constants.viewToShadow[c]));
+        constants.cascadeFar[c] = frame.cascadeFar[c];
+        constants.shadowBiasUnit[c] = frame.shadowBiasUnit[c];
+    }
+    constants.lightDir[0] = this->_lightDir.x();
+    constants.lightDir[1] = this->_lightDir.y();
+    constants.lightDir[2] = this->_lightDir.z();
+    constants.kd = this->_kd;
+    constants.ks = this->_ks;
+    constants.shininess = this->_shininess;
+
+    //  written whole, as the mapping is write-combined
+    GLintptr offset = this->_ring.allocate(sizeof(FrameConstants));
+    std::memcpy(this->_ring.data(offset), &constants, sizeof(constants));
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING,
+        this->_ring.buffer(), offset, sizeof(FrameConstants));
+    CG_ASSERT_GLCHECK();
+}
+
+void SSAORenderer::drawView(int view)
+{
+    for (int i = 0; i < this->_scene.batchCount(view); i++)
+    {
+        const Scene::Batch& batch = this->_scene.batch(view, i);
+        this->_frameGraph.bindVertexArray(batch.vertexArray);
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, batch.indexCount, batch.indexType, 0,
+            batch.instanceCount, batch.firstInstance);
+        this->_drawCalls++;
+    }
+    CG_ASSERT_GLCHECK();
+}
+
+//  all passes the current settings may need, with the resources they read
+//  and write; the graph culls those whose results are not used and
+//  schedules the rest
+void SSAORenderer::buildFrameGraph()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    graph.begin();
+    const bool compute = this->_computeSSAO && this->_aoTechnique == AO_Hemisphere;
+
+    int shadowMap = graph.resource("shadow map");
+    int gBuffer = graph.resource("g-buffer");
+    int aoPyramid = graph.resource("ao pyramid");
+    int hiz = graph.resource("hi-z");
+    int ssao = graph.resource("ssao");
+    int ssaoAccumulated = graph.resource("ssao history");
+    int ssaoBlurred = graph.resource("ssao blurred");
+    int ssaoFull = graph.resource("ssao full resolution");
+    int localLight = graph.resource("local lights");
+    int image = graph.resource("image");
+
+    //  the depth/normal input of everything at ssao resolution
+    int aoInput = this->_aoDivisor > 1 ? aoPyramid : gBuffer;
+
+    //  without a writer, the lighting reads the shadow map of an earlier frame
+    int pass;
+    if (frame.shadowUpdate)
+    {
+        pass = graph.addPass("shadow", [this]() { this->shadowPass(); });
+        graph.write(pass, shadowMap);
+    }
+
+    pass = graph.addPass("geometry", [this]() { this->geometryPass(); });
+    graph.write(pass, gBuffer);
+
+    if (this->_aoDivisor > 1)
+    {
+        pass = graph.addPass("ao_downsample", [this]() { this->aoDownsamplePass(); });
+        graph.read(pass, gBuffer);
+        graph.write(pass, aoPyramid);
+    }
+
+    if (this->_hiz)
+    {
+        pass = graph.addPass("hiz", [this]() { this->hizPass(); });
+        graph.read(pass, aoInput);
+        graph.write(pass, hiz);
+    }
+
+    if (compute)
+    {
+        //  ssao and blur in one dispatch
+        pass = graph.addPass("ssao", [this]() { this->ssaoComputePass(); });
+        graph.read(pass, aoInput);
+        if (this->_hiz)
+            graph.read(pass, hiz);
+        graph.write(pass, ssaoBlurred);
+    }
+    else
+    {
+        pass = graph.addPass("ssao", [this]() { this->ssaoPass(); });
+        graph.read(pass, aoInput);
+        if (this->_hiz)
+            graph.read(pass, hiz);
+        graph.write(pass, ssao);
+
+        //  the history of the previous frame has no writer in this one
+        int blurInput = ssao;
+        if (this->_temporal)
+        {
+            pass = graph.addPass("temporal", [this]() { this->temporalPass(); });
+            graph.read(pass, ssao);
+            graph.read(pass, aoInput);
+            graph.read(pass, gBuffer);
+            graph.write(pass, ssaoAccumulated);
+            blurInput = ssaoAccumulated;
+        }
+
+        pass = graph.addPass("blur", [this]() { this->blurPass(); });
+        graph.read(pass, blurInput);
+        graph.read(pass, aoInput);
+        graph.write(pass, ssaoBlurred);
+    }
+
+    int aoResult = ssaoBlurred;
+    if (this->_aoDivisor > 1)
+    {
+        pass = graph.addPass("ao_upsample", [this]() { this->aoUpsamplePass(); });
+        graph.read(pass, ssaoBlurred);
+        graph.read(pass, aoPyramid);
+        graph.read(pass, gBuffer);
+        graph.write(pass, ssaoFull);
+        aoResult = ssaoFull;
+    }
+
+    if (this->_localLights > 0)
+    {
+        pass = graph.addPass("lights", [this]() { this->lightsPass(); });
+        graph.read(pass, gBuffer);
+        graph.write(pass, localLight);
+    }
+
+    pass = graph.addPass("lighting", [this]() { this->lightingPass(); });
+    graph.read(pass, gBuffer);
+    if (this->_localLights > 0)
+        graph.read(pass, localLight);
+    if (this->_aoEnabled)
+        graph.read(pass, aoResult);
+    if (this->_shadowsEnabled)
+        graph.read(pass, shadowMap);
+    graph.write(pass, image);
+    graph.output(image);
+
+    graph.compile();
+}
+
+void SSAORenderer::drawScreenQuad()
+{
+    this->_frameGraph.bindVertexArray(this->_vao_plane);
+    glDrawElements(GL_TRIANGLES, this->_idxCount_plane, GL_UNSIGNED_INT, 0);
+    CG_ASSERT_GLCHECK();
+}
+
+//  Render Pass 1: Shadow
+//  only scheduled if the light or the shadow casters moved
+void SSAORenderer::shadowPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_Shadow);
+
+    // Set up view
+    graph.setViewport(this->_shadowMapSize, this->_shadowMapSize);
+    graph.setDepthTest(true);
+    graph.useProgram(this->_prg_shadow);
+
+    //  inverse face culling
+    glCullFace(GL_FRONT);
+
+    //  Render: draw the static casters into the static layers, if the
+    //  light or they moved
+    if (!this->_shadowStaticValid)
+    {
+        for (int c = 0; c < this->_shadowCascades; c++)
+        {
+            graph.bindFramebuffer(this->_fbo_depth_static[c]);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            this->_prg_shadow.setUniformValue("light_matrix", frame.PV_shadow[c]);
+            this->drawView(frame.shadowStaticView[c]);
+        }
+        this->_shadowStaticValid = true;
+        this->_shadowStaticVersion = this->_scene.staticVersion();
+    }
+
+    //  start from the static casters instead of clearing
+    glCopyImageSubData(this->_tex_depth_static, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+        this->_tex_depth, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+        this->_shadowMapSize, this->_shadowMapSize, this->_shadowCascades);
+
+    // Render: draw the dynamic casters into every cascade
+    for (int c = 0; c < this->_shadowCascades; c++)
+    {
+        graph.bindFramebuffer(this->_fbo_depth[c]);
+        this->_prg_shadow.setUniformValue("light_matrix", frame.PV_shadow[c]);
+        this->drawView(frame.shadowDynamicView[c]);
+    }
+
+    //  Set back to backface culling
+    glCullFace(GL_BACK);
+
+    for (int c = 0; c < this->_shadowCascades; c++)
+        this->_shadowPV[c] = frame.PV_shadow[c];
+    this->_shadowDynamicVersion = this->_scene.dynamicVersion();
+    this->_shadowPassSkipped = false;
+    this->endPass(Pass_Shadow);
+}
+
+//  Render Pass 2: G-Buffer
+void SSAORenderer::geometryPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_Geometry);
+
+    // Set up framebuffer
+    graph.bindFramebuffer(this->_fbo_geom);
+    graph.setViewport(frame.width, frame.height);
+    graph.setDepthTest(true);
+    if (this->rejectsBackground())
+    {
+        //  mark the drawn pixels, for the ssao pass
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, 1, 0xff);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+    else
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Render: draw all visible instances
+    graph.useProgram(this->_prg_geom);
+    this->drawView(frame.cameraView);
+    if (this->rejectsBackground())
+        glDisable(GL_STENCIL_TEST);
+
+    this->endPass(Pass_Geometry);
+}
+
+//  Render Pass 3a: Depth/normal pyramid for reduced resolution ssao
+void SSAORenderer::aoDownsamplePass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_AODownsample);
+    graph.setDepthTest(false);
+
+    //  the first level reads the g-buffer, every further one its predecessor
+    GLsizei levelWidth = frame.width, levelHeight = frame.height;
+    for (int level = 0; level < AO_PYRAMID_LEVELS; level++)
+    {
+        const AOLevel& l = this->_aoPyramid[level];
+        if (l.fbo == 0)
+            break;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+        graph.bindFramebuffer(l.fbo);
+        graph.setViewport(levelWidth, levelHeight);
+
+        if (level == 0)
+        {
+            graph.useProgram(this->_prg_ao_downsample_gbuffer);
+            graph.bindTexture(0, frame.positionSource);
+            graph.bindTexture(1, this->_gBuffer.normal);
+        }
+        else
+        {
+            graph.useProgram(this->_prg_ao_downsample);
+            graph.bindTexture(0, this->_aoPyramid[level - 1].viewZ);
+            graph.bindTexture(1, this->_aoPyramid[level - 1].normal);
+        }
+        this->drawScreenQuad();
+    }
+
+    this->endPass(Pass_AODownsample);
+}
+
+//  Render Pass 3b: Min/max depth pyramid
+void SSAORenderer::hizPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_HiZ);
+    graph.setDepthTest(false);
+
+    GLsizei levelWidth = this->_aoWidth, levelHeight = this->_aoHeight;
+    for (int level = 0; level < this->_hizLevels; level++)
+    {
+        graph.bindFramebuffer(this->_fbo_hiz[level]);
+        graph.setViewport(levelWidth, levelHeight);
+
+        if (level == 0)
+        {
+            graph.useProgram(this->_prg_hiz_gbuffer);
+            this->_prg_hiz_gbuffer.setUniformValue("target_size", QVector2D(levelWidth, levelHeight));
+            graph.bindTexture(0, frame.aoLevel ? frame.aoLevel->viewZ : frame.positionSource);
+        }
+        else
+        {
+            //  restrict the texture to the source level, so that the
+            //  level being rendered to is not a feedback loop
+            graph.useProgram(this->_prg_hiz);
+            graph.bindTexture(0, this->_tex_hiz);
+            glTextureParameteri(this->_tex_hiz, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTextureParameteri(this->_tex_hiz, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        this->drawScreenQuad();
+
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+
+    //  make all levels visible again
+    glTextureParameteri(this->_tex_hiz, GL_TEXTURE_BASE_LEVEL, 0);
+    glTextureParameteri(this->_tex_hiz, GL_TEXTURE_MAX_LEVEL, this->_hizLevels - 1);
+
+    this->endPass(Pass_HiZ);
+}
+
+//  Render Pass 3/4: SSAO and blur in one compute dispatch
+void SSAORenderer::ssaoComputePass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    GLsizei aoWidth = this->_aoWidth, aoHeight = this->_aoHeight;
+    this->beginPass(Pass_SSAO);
+
+    graph.useProgram(*this->_prg_ssao_compute);
+    this->_prg_ssao_compute->setUniformValue("noiseScale", QVector2D( aoWidth / 4.0f, aoHeight / 4.0f));
+    this->_prg_ssao_compute->setUniformValue("depth_sharpness", this->_blurDepthSharpness);
+    this->_prg_ssao_compute->setUniformValue("normal_power", this->_blurNormalPower);
+    this->_prg_ssao_compute->setUniformValue("radius", this->_aoRadius);
+    this->_prg_ssao_compute->setUniformValue("bias", this->_hemisphere.bias);
+    this->_prg_ssao_compute->setUniformValue("hiz_max_level", this->_hizLevels - 1);
+    graph.bindTexture(0, frame.aoLevel ? frame.aoLevel->viewZ : frame.positionSource);
+    graph.bindTexture(1, frame.aoLevel ? frame.aoLevel->normal : this->_gBuffer.normal);
+    graph.bindTexture(2, this->_tex_noise);
+    graph.bindTexture(3, this->_tex_hiz);
+    glBindImageTexture(0, this->_tex_ssao_compute, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+        this->_compactGBuffer ? GL_R8 : GL_R16F);
+    glDispatchCompute((aoWidth + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE,
+        (aoHeight + COMPUTE_TILE_SIZE - 1) / COMPUTE_TILE_SIZE, 1);
+    //  make the image writes visible to the texture fetches that follow
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    CG_ASSERT_GLCHECK();
+
+    this->endPass(Pass_SSAO);
+}
+
+//  Render Pass 3: SSAO
+void SSAORenderer::ssaoPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    GLsizei aoWidth = this->_aoWidth, aoHeight = this->_aoHeight;
+    this->beginPass(Pass_SSAO);
+
+    // Set up framebuffer
+    graph.bindFramebuffer(this->_fbo_ssao);
+    graph.setViewport(aoWidth, aoHeight);
+    graph.setDepthTest(false);
+    if (this->_adaptiveAO)
+    {
+        //  what the skipped background keeps: no occlusion, no taps
+        static const float open[4] = { 1.0f, 1.0f, 1.0f, 1.0f }, none[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, open);
+        glClearBufferfv(GL_COLOR, 1, none);
+    }
+    else
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    if (this->rejectsBackground())
+    {
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_EQUAL, 1, 0xff);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    }
+
+    // Render: draw ssao texture
+    graph.useProgram(*this->_prg_ssao);
+    //  temporal mode: a rotated noise pattern per frame (and for the
+    //  hemisphere an interleaved subset of the kernel), so that the
+    //  history sees all of it
+    float noiseAngle = this->_temporal ? this->_frameIndex * 2.3999632f : 0.0f;  // golden angle
+    this->_prg_ssao->setUniformValue("noise_rotation", QVector2D(cosf(noiseAngle), sinf(noiseAngle)));
+    switch (this->_aoTechnique)
+    {
+    case AO_Hemisphere:
+    {
+        //  the kernel and the sample count are compiled into the variant
+        int sampleCount = this->_temporal ? this->_temporalSamples : this->_hemisphere.samples;
+        int sampleStride = 64 / sampleCount;
+        this->_prg_ssao->setUniformValue("sample_stride", sampleStride);
+        this->_prg_ssao->setUniformValue("sample_offset", static_cast<int>(this->_frameIndex % sampleStride));
+        this->_prg_ssao->setUniformValue("bias", this->_hemisphere.bias);
+        break;
+    }
+    case AO_HBAO:
+        this->_prg_ssao->setUniformValue("angle_bias", this->_hbao.angleBias);
+        break;
+    case AO_GTAO:
+        this->_prg_ssao->setUniformValue("falloff_range", this->_gtao.falloffRange);
+        break;
+    default:
+        break;
+    }
+    this->_prg_ssao->setUniformValue("noiseScale", QVector2D( aoWidth / 4.0f, aoHeight / 4.0f));
+    this->_prg_ssao->setUniformValue("radius", this->_aoRadius);
+    this->_prg_ssao->setUniformValue("hiz_max_level", this->_hizLevels - 1);
+    graph.bindTexture(0, frame.aoLevel ? frame.aoLevel->viewZ : frame.positionSource);
+    graph.bindTexture(1, frame.aoLevel ? frame.aoLevel->normal : this->_gBuffer.normal);
+    graph.bindTexture(2, this->_tex_noise);
+    graph.bindTexture(3, this->_tex_hiz);
+    this->drawScreenQuad();
+    if (this->rejectsBackground())
+        glDisable(GL_STENCIL_TEST);
+
+    this->endPass(Pass_SSAO);
+
+    //  outside of the pass, so that its time does not include the mean
+    if (this->_timingEnabled && this->_adaptiveAO && this->_aoTechnique == AO_Hemisphere)
+        this->measureAOSamples();
+}
+
+//  the mipmaps box-filter the taps per pixel down to (roughly, at sizes
+//  that are no power of two) their mean, which is copied into the buffer
+//  slot of this frame's timer set without waiting for it
+void SSAORenderer::measureAOSamples()
+{
+    if (this->_buf_ssao_samples == 0)
+    {
+        glCreateBuffers(1, &this->_buf_ssao_samples);
+        glNamedBufferStorage(this->_buf_ssao_samples, 2 * sizeof(float), NULL, 0);
+    }
+    unsigned int set = this->_timerFrame & 1;
+    glGenerateTextureMipmap(this->_tex_ssao_samples);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, this->_buf_ssao_samples);
+    glGetTextureImage(this->_tex_ssao_samples, this->_ssaoSamplesLevels - 1, GL_RED, GL_FLOAT,
+        sizeof(float), reinterpret_cast<void*>(set * sizeof(float)));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    this->_ssaoSamplesIssued[set] = true;
+    CG_ASSERT_GLCHECK();
+}
+
+//  Render Pass 3c: Temporal accumulation
+void SSAORenderer::temporalPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_Temporal);
+
+    unsigned int current = this->_historyIndex, previous = 1 - this->_historyIndex;
+    graph.bindFramebuffer(this->_fbo_ssao_history[current]);
+    graph.setViewport(this->_aoWidth, this->_aoHeight);
+    graph.setDepthTest(false);
+
+    graph.useProgram(this->_prg_ssao_temporal);
+    this->_prg_ssao_temporal.setUniformValue("history_valid", this->_historyValid);
+    this->_prg_ssao_temporal.setUniformValue("blend_factor", this->_temporalBlend);
+    this->_prg_ssao_temporal.setUniformValue("depth_tolerance", this->_temporalDepthTolerance);
+    graph.bindTexture(0, this->_tex_ssao);
+    graph.bindTexture(1, this->_tex_ssao_history[previous]);
+    graph.bindTexture(2, this->_gBuffer.motion);
+    graph.bindTexture(3, frame.aoLevel ? frame.aoLevel->viewZ : frame.positionSource);
+    this->drawScreenQuad();
+
+    this->endPass(Pass_Temporal);
+}
+
+//  Render Pass 4: Blurring
+//  separable bilateral filter: horizontal into the intermediate
+//  buffer, then vertical into the blur buffer
+void SSAORenderer::blurPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_Blur);
+
+    graph.setViewport(this->_aoWidth, this->_aoHeight);
+    graph.setDepthTest(false);
+    graph.useProgram(*this->_prg_ssao_blur);
+    this->_prg_ssao_blur->setUniformValue("depth_sharpness", this->_blurDepthSharpness);
+    this->_prg_ssao_blur->setUniformValue("normal_power", this->_blurNormalPower);
+    graph.bindTexture(1, frame.aoLevel ? frame.aoLevel->viewZ : frame.positionSource);
+    graph.bindTexture(2, frame.aoLevel ? frame.aoLevel->normal : this->_gBuffer.normal);
+
+    //  Render: horizontal pass
+    graph.bindFramebuffer(this->_fbo_ssao_blur_tmp);
+    this->_prg_ssao_blur->setUniformValue("blur_direction", QVector2D(1.0f / this->_aoWidth, 0.0f));
+    graph.bindTexture(0, frame.aoRaw);
+    this->drawScreenQuad();
+
+    //  Render: vertical pass
+    graph.bindFramebuffer(this->_fbo_ssao_blur);
+    this->_prg_ssao_blur->setUniformValue("blur_direction", QVector2D(0.0f, 1.0f / this->_aoHeight));
+    graph.bindTexture(0, this->_tex_ssao_blur_tmp);
+    this->drawScreenQuad();
+
+    this->endPass(Pass_Blur);
+}
+
+//  Render Pass 4a: Depth-aware upsampling of reduced resolution ssao
+void SSAORenderer::aoUpsamplePass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_AOUpsample);
+
+    //  back to full resolution
+    graph.bindFramebuffer(this->_fbo_ssao_full);
+    graph.setViewport(frame.width, frame.height);
+    graph.setDepthTest(false);
+
+    graph.useProgram(this->_prg_ao_upsample);
+    graph.bindTexture(0, frame.positionSource);
+    graph.bindTexture(1, this->_gBuffer.normal);
+    graph.bindTexture(2, frame.aoBlurred);
+    graph.bindTexture(3, frame.aoLevel->viewZ);
+    graph.bindTexture(4, frame.aoLevel->normal);
+    this->drawScreenQuad();
+
+    this->endPass(Pass_AOUpsample);
+}
+
+//  Render Pass 4b: Point and spot lights
+void SSAORenderer::lightsPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_Lights);
+
+    graph.useProgram(*this->_prg_lights);
+    this->_prg_lights->setUniformValue("light_count", this->_localLights);
+    graph.bindTexture(0, frame.positionSource);
+    graph.bindTexture(1, this->_gBuffer.normal);
+    graph.bindTexture(2, this->_gBuffer.depth);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->_ssbo_lights);
+    if (this->_lightCulling == LightCulling_Tiled)
+    {
+        //  a counter per timer set, so that reading one does not wait
+        if (this->_buf_light_overflow[0] == 0)
+        {
+            glCreateBuffers(2, this->_buf_light_overflow);
+            for (int i = 0; i < 2; i++)
+                glNamedBufferStorage(this->_buf_light_overflow[i], sizeof(GLuint), NULL, GL_DYNAMIC_STORAGE_BIT);
+        }
+        unsigned int set = this->_timerFrame & 1;
+        const GLuint zero = 0;
+        glClearNamedBufferData(this->_buf_light_overflow[set], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->_buf_light_overflow[set]);
+        this->_lightOverflowIssued[set] = this->_timingEnabled;
+    }
+    glBindImageTexture(0, this->_tex_local_light, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glDispatchCompute((this->_width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE,
+        (this->_height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    CG_ASSERT_GLCHECK();
+
+    this->endPass(Pass_Lights);
+}
+
+//  Render Pass 5: Main Pass
+void SSAORenderer::lightingPass()
+{
+    FrameGraph& graph = this->_frameGraph;
+    const FrameState& frame = this->_frame;
+    this->beginPass(Pass_Lighting);
+
+    // Set up view
+    graph.bindFramebuffer(frame.targetFbo);
+    graph.setViewport(frame.width, frame.height);
+    graph.setDepthTest(true);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Render: lighting
+    graph.useProgram(*this->_prg_main);
+    graph.bindTexture(0, frame.positionSource);
+    graph.bindTexture(1, this->_gBuffer.normal);
+    graph.bindTexture(2, this->_gBuffer.albedo);
+    if (this->_shadowsEnabled)
+    {
+        graph.bindTexture(3, this->_gBuffer.shadow);
+        graph.bindTexture(5, this->_tex_depth);
+    }
+    if (this->_aoEnabled)
+        graph.bindTexture(4, frame.aoResult);
+    if (this->_localLights > 0)
+        graph.bindTexture(6, this->_tex_local_light);
+    this->drawScreenQuad();
+
+    this->endPass(Pass_Lighting);
+}
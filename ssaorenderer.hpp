@@ -0,0 +1,725 @@
+#ifndef SSAORENDERER_HPP
+#define SSAORENDERER_HPP
+
+#include <QHash>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+
+#include "framegraph.hpp"
+#include "rendertargetpool.hpp"
+#include "ringbuffer.hpp"
+#include "scene.hpp"
+
+//  The complete SSAO pipeline (shadow, g-buffer, ssao, blur and lighting),
+//  independent of any window so that it can also be driven offscreen.
+//  All member functions expect the OpenGL context to be current.
+class SSAORenderer : protected QOpenGLFunctions_4_5_Core
+{
+public:
+
+    //  render passes, in execution order
+    enum Pass
+    {
+        Pass_Shadow,
+        Pass_Geometry,
+        Pass_AODownsample,
+        Pass_HiZ,
+        Pass_SSAO,
+        Pass_Temporal,
+        Pass_Blur,
+        Pass_AOUpsample,
+        Pass_Lights,
+        Pass_Lighting,
+        PassCount
+    };
+
+    //  human-readable pass name, e.g. for benchmark output
+    static const char* passName(int pass);
+
+    //  ambient occlusion techniques, each with its own shader writing
+    //  visibility (1 = unoccluded) into the ssao target
+    enum AOTechnique
+    {
+        AO_Hemisphere,  // normal-oriented hemisphere kernel (Crytek/LearnOpenGL style)
+        AO_HBAO,        // horizon-based ao
+        AO_GTAO,        // ground-truth ao
+        AOTechniqueCount
+    };
+
+    //  short technique name, as used on the command line
+    static const char* aoTechniqueName(int technique);
+
+    //  shadow map filters (see shadow.glsl). all but the plain pcf read
+    //  the map through a depth-comparison sampler with bilinear filtering,
+    //  so that one fetch compares four texels
+    enum ShadowFilter
+    {
+        Shadow_PCF,             // compare every texel of the kernel by hand
+        Shadow_HardwarePCF,     // grid of bilinear compares, two texels apart
+        Shadow_OptimizedPCF,    // tent filter from weighted bilinear compares
+        Shadow_Poisson,         // rotated disk of bilinear compares
+        ShadowFilterCount
+    };
+
+    //  short filter name, as used on the command line
+    static const char* shadowFilterName(int filter);
+
+    //  shadow map fetches per pixel of a filter and pcf kernel size
+    static int shadowFetches(ShadowFilter filter, int pcfSize);
+
+    //  how the point and spot lights are found for a pixel (see
+    //  cs_lights.glsl)
+    enum LightCulling
+    {
+        LightCulling_Tiled,     // culled per 16x16 tile and its depth range
+        LightCulling_None,      // every pixel evaluates every light
+        LightCullingCount
+    };
+
+    //  short culling name, as used on the command line
+    static const char* lightCullingName(int culling);
+
+    //  quality tiers. a tier sets all sample counts that are compiled
+    //  into the shaders, see QualitySettings.
+    enum Quality
+    {
+        Quality_Low,
+        Quality_Medium,
+        Quality_High,
+        Quality_Ultra,
+        QualityCount
+    };
+
+    //  short tier name, as used on the command line
+    static const char* qualityName(int quality);
+
+    //  everything a quality tier controls
+    struct QualitySettings
+    {
+        int hemisphereSamples;
+        int hbaoDirections, hbaoSteps;
+        int gtaoSlices, gtaoSteps;
+        int blurRadius;
+        int pcfSize;
+    };
+    static QualitySettings qualitySettings(Quality quality);
+
+    //  parameter blocks of the techniques
+    struct HemisphereParameters
+    {
+        int samples;        // kernel samples (4..64, power of two)
+        float bias;         // depth bias against self-occlusion
+    };
+    struct HBAOParameters
+    {
+        int directions;     // directions around the pixel
+        int steps;          // steps per direction
+        float angleBias;    // elevation above the tangent plane ignored (radians)
+    };
+    struct GTAOParameters
+    {
+        int slices;         // slices through the view vector (2 directions each)
+        int steps;          // steps per direction
+        float falloffRange; // part of the radius over which occluders fade out
+    };
+
+    //  linked program binaries are cached in this directory, keyed by
+    //  shader sources and driver (vendor, renderer and version), so that
+    //  only the first run compiles. defaults to <cache location>/programs,
+    //  an empty directory disables the cache.
+    static QString programCacheDirectory();
+    static void setProgramCacheDirectory(const QString& directory);
+
+    //  models are converted from OBJ into optimized binary mesh files in
+    //  this directory, keyed by the OBJ contents, and later runs map those
+    //  instead of parsing. defaults to <cache location>/meshes, an empty
+    //  directory disables the cache, and models are drawn as parsed.
+    static QString meshCacheDirectory();
+    static void setMeshCacheDirectory(const QString& directory);
+
+    //  fixed camera used when there is no interactive navigator
+    static void defaultCamera(int width, int height, QMatrix4x4& P, QMatrix4x4& V);
+
+private:
+
+    //  screen size the targets were allocated with
+    int _width, _height;
+
+    //  steps of a frame, in execution order: the lifetimes of targets
+    enum Step
+    {
+        Step_Geometry,
+        Step_AODownsample,
+        Step_HiZ,
+        Step_SSAO,
+        Step_Temporal,
+        Step_BlurHorizontal,
+        Step_BlurVertical,
+        Step_AOUpsample,
+        Step_Lights,
+        Step_Lighting,
+        Step_Persistent     // end of targets that are read by the next frame
+    };
+
+    //  textures of all screen-size dependent targets
+    RenderTargetPool _targetPool;
+
+    //  lighting variables
+    float _kd, _ks, _shininess;
+
+    //  scene properties
+    //  light direction towards the center of the scene
+    //  WARNING!! normalize it everytime
+    QVector3D _lightDir;
+    //  azimuth angle to move the direction vector
+    int _lightAzimuthAngle;
+
+    //  model rotation angle in degrees, and whether it advances by itself
+    float _modelAngle;
+    bool _animated;
+
+    //  reconstruct view-space positions from the depth buffer
+    //  instead of storing them in the g-buffer
+    bool _reconstructPosition;
+
+    //  octahedral RG16 normals, no shadow coordinate target and R8 ao
+    //  targets instead of the half float ones
+    bool _compactGBuffer;
+
+    //  ssao is computed at 1/_aoDivisor of the screen resolution
+    int _aoDivisor;
+    int _aoWidth, _aoHeight;
+
+    //  ssao kernel radius in view-space units
+    float _aoRadius;
+
+    //  quality tier applied last, and the size of the shadow pcf kernel
+    Quality _quality;
+    int _pcfSize;
+
+    //  selected ao technique and the parameters of all techniques
+    AOTechnique _aoTechnique;
+    HemisphereParameters _hemisphere;
+    HBAOParameters _hbao;
+    GTAOParameters _gtao;
+
+    //  separable bilateral blur: radius in texels per direction,
+    //  and how strongly depth and normal differences reduce the weights
+    int _blurRadius;
+    float _blurDepthSharpness, _blurNormalPower;
+
+    //  run ssao and blur as one compute dispatch instead of fragment passes
+    bool _computeSSAO;
+    unsigned int _tex_ssao_compute;
+
+    //  temporal ssao: few samples per frame, accumulated over frames
+    //  in a reprojected history buffer
+    bool _temporal;
+    int _temporalSamples;
+    float _temporalBlend, _temporalDepthTolerance;
+    unsigned int _tex_ssao_history[2], _fbo_ssao_history[2];
+    int _historyIndex;
+    bool _historyValid;
+    unsigned int _frameIndex;
+
+    //  transformations of the previous frame, for motion vectors
+    QMatrix4x4 _prevP, _prevV;
+
+    //  compiled program variants, keyed by shader files and defines.
+    //  variants stay alive, so that switching back to one costs nothing.
+    QHash<QString, QOpenGLShaderProgram*> _programVariants;
+
+    //  variants in use, i.e. programs with compile-time sample counts
+    QOpenGLShaderProgram* _prg_main;
+    QOpenGLShaderProgram* _prg_ssao;
+    QOpenGLShaderProgram* _prg_ssao_blur;
+    QOpenGLShaderProgram* _prg_ssao_compute;
+
+    //  shared objects
+    QOpenGLShaderProgram _prg_geom,
+        _prg_shadow,
+        _prg_ao_downsample_gbuffer,
+        _prg_ao_downsample,
+        _prg_ao_upsample,
+        _prg_ssao_temporal,
+        _prg_hiz_gbuffer,
+        _prg_hiz;
+
+    //  objects for plane (base scene, also the screen quad)
+    unsigned int _vao_plane,
+        _idxCount_plane;
+
+    //  the scene: the plane and a grid of _sceneObjects models on it,
+    //  all rotating by _modelAngle around their placement
+    Scene _scene;
+    int _mesh_plane, _mesh_model;
+    int _sceneObjects;
+    int _firstModelInstance;
+    QVector<QMatrix4x4> _modelPlacements;
+    int _drawCalls;     // of the last frame
+    double _meshLoadTime;
+    bool _meshCacheHit;
+
+    //  objects for depth map: a texture array with one layer per
+    //  cascade, each fitted to its slice of the view frustum
+    enum { SHADOW_MAX_CASCADES = 4 };
+    int _shadowCascades, _shadowMapSize;
+    ShadowFilter _shadowFilter;
+    unsigned int _tex_depth,
+        _fbo_depth[SHADOW_MAX_CASCADES];
+
+    //  shadow map of the static casters (the plane), rendered only when
+    //  the light changes. the shadow pass copies it into the depth map and
+    //  adds the dynamic casters, or is skipped if nothing moved.
+    unsigned int _tex_depth_static,
+        _fbo_depth_static[SHADOW_MAX_CASCADES];
+    bool _shadowStaticValid;
+    QMatrix4x4 _shadowPV[SHADOW_MAX_CASCADES];     // what the depth map shows
+    int _shadowStaticVersion, _shadowDynamicVersion;
+    bool _shadowPassSkipped;
+
+    //  objects for g-buffer
+    struct GBuffer
+    {
+        unsigned int position,
+            normal,
+            albedo,
+            shadow,
+            motion,
+            depth;
+    }
+    _gBuffer;
+    unsigned int _fbo_geom;
+
+    //  objects for ssao buffer
+    unsigned int _tex_ssao, _tex_ssao_blur, _tex_ssao_blur_tmp,
+        _fbo_ssao, _fbo_ssao_blur, _fbo_ssao_blur_tmp,
+        _tex_noise;
+
+    //  downsampled view depth and normals for reduced resolution ssao,
+    //  level 0 is half resolution, level 1 quarter resolution
+    enum { AO_PYRAMID_LEVELS = 2 };
+    struct AOLevel
+    {
+        unsigned int viewZ,
+            normal,
+            fbo;
+    }
+    _aoPyramid[AO_PYRAMID_LEVELS];
+
+    //  min/max view depth pyramid at ssao resolution (r = farthest,
+    //  g = closest), one FBO per level. ssao reads distant taps from
+    //  coarser levels.
+    enum { HIZ_MAX_LEVELS = 5 };
+    bool _hiz;
+    int _hizLevels;
+    unsigned int _tex_hiz, _fbo_hiz[HIZ_MAX_LEVELS];
+
+    //  bilaterally upsampled ssao at full resolution
+    unsigned int _tex_ssao_full, _fbo_ssao_full;
+
+    //  adaptive ssao. the hemisphere writes its taps per pixel into a
+    //  mipmapped target, whose 1x1 level is copied into the buffer slot
+    //  of the frame's timer set and read back with the timer queries.
+    bool _adaptiveAO;
+    unsigned int _tex_ssao_samples;
+    int _ssaoSamplesLevels;
+    unsigned int _buf_ssao_samples;
+    bool _ssaoSamplesIssued[2];
+    float _meanAOSamples;
+
+    //  ssao kernel (a uniform buffer, bound once) and noise texture object
+    unsigned int _ubo_ssao_kernel;
+    QVector<QVector3D> _ssaoNoise;
+
+    //  whether the lighting uses ao and shadows. the passes that only
+    //  feed a disabled input are culled by the frame graph.
+    bool _aoEnabled, _shadowsEnabled;
+
+    //  point and spot light as cs_lights.glsl reads it (std430), in
+    //  world space
+    struct LocalLight
+    {
+        float position[3], radius;
+        float color[3], cosInner;
+        float direction[3], cosOuter;   // -1 for point lights
+    };
+
+    //  point and spot lights scattered over the scene, in a shader
+    //  storage buffer, and their lighting at full resolution
+    int _localLights;
+    LightCulling _lightCulling;
+    unsigned int _ssbo_lights, _tex_local_light;
+    QOpenGLShaderProgram* _prg_lights;
+
+    //  tiles with more lights than the tiled culling keeps, counted into
+    //  a buffer per timer set and read back with the timer queries
+    unsigned int _buf_light_overflow[2];
+    bool _lightOverflowIssued[2];
+    int _lightOverflowTiles;
+
+    //  passes of the current frame, scheduled every frame
+    FrameGraph _frameGraph;
+
+    //  the data written every frame: the instances and the frame constants
+    RingBuffer _ring;
+
+    //  the uniform block of frame.glsl, in its std140 layout. matrices
+    //  are column-major, as QMatrix4x4 stores them.
+    struct FrameConstants
+    {
+        float P[16], P_inverse[16], V[16];
+        float prevP[16], prevV[16];
+        float PV_shadow[16];
+        float viewToShadow[SHADOW_MAX_CASCADES][16];
+        float cascadeFar[SHADOW_MAX_CASCADES];
+        float shadowBiasUnit[SHADOW_MAX_CASCADES];
+        float lightDir[3], kd;
+        float ks, shininess, padding[2];
+    };
+
+    //  per-frame values shared by the passes
+    struct FrameState
+    {
+        QMatrix4x4 P, V, P_inverse;
+        QMatrix4x4 PV_shadow[SHADOW_MAX_CASCADES];
+        float cascadeFar[SHADOW_MAX_CASCADES];      // view depth covered by each cascade
+        float shadowBiasUnit[SHADOW_MAX_CASCADES];  // texel size relative to the depth range
+        bool shadowUpdate;                          // the shadow maps are out of date
+
+        //  scene views of the passes, -1 if not culled this frame
+        int cameraView;
+        int shadowStaticView[SHADOW_MAX_CASCADES], shadowDynamicView[SHADOW_MAX_CASCADES];
+        GLsizei width, height;
+        unsigned int targetFbo;
+        unsigned int positionSource;    // position buffer or depth buffer
+        const AOLevel* aoLevel;         // pyramid level at ssao resolution
+        unsigned int aoRaw;             // ssao or its temporal accumulation
+        unsigned int aoBlurred;         // blurred ssao at ssao resolution
+        unsigned int aoResult;          // ssao read by the lighting
+    }
+    _frame;
+
+    //  GPU timer queries (GL_TIME_ELAPSED), one set per pass.
+    //  two sets are used alternately, so that the results of the previous
+    //  frame are read back while the current one is being recorded.
+    bool _timingEnabled;
+    unsigned int _timerQueries[2][PassCount];
+    bool _timerIssued[2][PassCount];
+    unsigned int _timerFrame;
+    double _passTimes[PassCount];
+    bool _passTimesValid;
+
+    //  intialize scene objects
+    void initializeScene();
+
+    //  add a mesh of an OBJ file to the scene, through the mesh cache
+    int loadMesh(const char* fileName);
+
+    //  (re)place the instances of the scene, for _sceneObjects models
+    void setupSceneInstances();
+
+    //  cull the instances for the views of this frame
+    void cullScene();
+
+    //  write the frame constants of _frame into the ring and bind them
+    void uploadFrameConstants();
+
+    //  one instanced draw per mesh with visible instances in a view
+    void drawView(int view);
+
+    //  setup g-buffer and ssao targets for the current size and settings
+    void setupTargets();
+    void releaseFramebuffers();
+
+    //  (re)build all programs that depend on the g-buffer layout
+    //  or the ao resolution
+    void setupPrograms();
+
+    //  fetch a program variant, compiling it on first use
+    QOpenGLShaderProgram* programVariant(const char* vs, const char* fs, const QString& defines);
+    QOpenGLShaderProgram* computeVariant(const char* cs, const QString& defines);
+
+    //  variants of the programs with compile-time sample counts,
+    //  for the current g-buffer layout, ao resolution and technique
+    QOpenGLShaderProgram* ssaoVariant(const QualitySettings& settings);
+    QOpenGLShaderProgram* blurVariant(int blurRadius);
+    QOpenGLShaderProgram* computeSSAOVariant(const QualitySettings& settings);
+    QOpenGLShaderProgram* lightingVariant(int pcfSize);
+    QOpenGLShaderProgram* lightsVariant();
+
+    //  the settings currently in effect, as a tier would set them
+    QualitySettings currentQualitySettings() const;
+
+    //  declare the passes of a frame with their dependencies
+    void buildFrameGraph();
+
+    //  the passes, reading their parameters from _frame
+    void shadowPass();
+    void geometryPass();
+    void aoDownsamplePass();
+    void hizPass();
+    void ssaoPass();
+    void ssaoComputePass();
+    void temporalPass();
+    void blurPass();
+    void aoUpsamplePass();
+    void lightsPass();
+    void lightingPass();
+
+    //  draw the screen-filling quad of the deferred passes
+    void drawScreenQuad();
+
+    //  select the variants for the current settings
+    void selectVariants();
+
+    //  compile the variants of all tiers, so that switching tiers never
+    //  waits for the shader compiler
+    void precompileQualityTiers();
+
+    //  setup SSAO pipeline, kernel and noise texture
+    void setupSSAOPass();
+
+    //  setup SSAO kernel and noise texture
+    void setupSSAOKernel();
+
+    //  (re)create the buffer of the local lights for their count
+    void setupLocalLights();
+
+    //  setup shadow map pipeline
+    void setupShadowPass();
+
+    //  (re)create the shadow maps for the current size and cascade count
+    void setupShadowMaps();
+    void releaseShadowMaps();
+
+    //  sampler state of the depth map the lighting reads, for the filter
+    void setupShadowSampling();
+
+    //  fit the light frustum of every cascade to its slice of the view
+    //  frustum and the scene bounds, into _frame
+    void fitShadowCascades(const QMatrix4x4& P, const QMatrix4x4& V);
+
+    //  whether the g-buffer stores shadow map coordinates, instead of the
+    //  lighting computing them from the position
+    bool storesShadowCoords() const { return !_compactGBuffer && _shadowCascades == 1; }
+
+    //  whether the geometry pass marks the drawn pixels in the stencil,
+    //  for the ssao pass to skip the background. only at the same
+    //  resolution, and not when the ssao samples the depth texture, which
+    //  would then also be attached (a feedback loop)
+    bool rejectsBackground() const { return _adaptiveAO && _aoDivisor == 1 && !_reconstructPosition; }
+
+    //  average the taps per pixel of the adaptive hemisphere on the GPU
+    void measureAOSamples();
+
+    //  wrap a pass into a timer query (no-op if timing is disabled)
+    void beginPass(Pass pass);
+    void endPass(Pass pass);
+
+    //  collect the timer results of the previous frame
+    void collectPassTimes();
+
+public:
+    SSAORenderer();
+    ~SSAORenderer();
+
+    //  create all GL objects for a screen of the given size
+    void initialize(int width, int height);
+
+    //  render one frame into the framebuffer targetFbo.
+    //  deltaTime (in seconds) advances the model animation.
+    //  the targets follow the size w x h, so this also handles resizes.
+    void render(const QMatrix4x4& P, const QMatrix4x4& V, int w, int h,
+        float deltaTime, unsigned int targetFbo = 0);
+
+    //  lighting parameters
+    float kd() const { return _kd; }
+    float ks() const { return _ks; }
+    float shininess() const { return _shininess; }
+    void setKd(float kd) { _kd = kd; }
+    void setKs(float ks) { _ks = ks; }
+    void setShininess(float shininess) { _shininess = shininess; }
+
+    //  light direction, given as azimuth angle in degrees
+    int lightAzimuthAngle() const { return _lightAzimuthAngle; }
+    void setLightAzimuthAngle(int degrees);
+
+    //  model animation
+    float modelAngle() const { return _modelAngle; }
+    void setModelAngle(float degrees) { _modelAngle = degrees; }
+
+    //  number of models in the scene, placed in a grid on the plane
+    int sceneObjects() const { return _sceneObjects; }
+    void setSceneObjects(int count);
+
+    //  draws issued by the last frame (all passes), and the instances
+    //  that passed the camera's frustum culling
+    int drawCalls() const { return _drawCalls; }
+    int visibleInstances() const { return _scene.visibleInstances(_frame.cameraView); }
+
+    //  milliseconds initialize() took to load the model, and whether it
+    //  was mapped from the mesh cache rather than parsed
+    double meshLoadTime() const { return _meshLoadTime; }
+    bool meshCacheHit() const { return _meshCacheHit; }
+
+    //  frames that waited for the GPU to free their part of the ring
+    //  buffer, i.e. that were more than RingBuffer::FRAMES_IN_FLIGHT ahead
+    int ringWaits() const { return _ring.waits(); }
+
+    //  the full resolution ao (red channel) the last frame was lit with,
+    //  0 without ao. valid until the next frame.
+    unsigned int aoTexture() const { return _aoEnabled ? _frame.aoResult : 0; }
+    bool isAnimated() const { return _animated; }
+    void setAnimated(bool animated) { _animated = animated; }
+
+    //  g-buffer layout: reconstruct positions from depth (saves the
+    //  RGB16F position target and most of the ssao pass bandwidth)
+    bool reconstructPosition() const { return _reconstructPosition; }
+    void setReconstructPosition(bool reconstruct);
+
+    //  compact g-buffer layout: octahedral encoded RG16 normals, R8 ao
+    //  targets, and shadow map coordinates computed from the position in
+    //  the lighting pass instead of stored in an RGB16F target
+    bool compactGBuffer() const { return _compactGBuffer; }
+    void setCompactGBuffer(bool compact);
+
+    //  ssao resolution as divisor of the screen resolution (1, 2 or 4).
+    //  reduced resolution ssao is upsampled with a depth-aware filter.
+    int aoDivisor() const { return _aoDivisor; }
+    void setAODivisor(int divisor);
+
+    //  ssao kernel radius (view-space units). with the depth pyramid,
+    //  larger radii cost little more memory bandwidth than small ones.
+    float aoRadius() const { return _aoRadius; }
+    void setAORadius(float radius) { _aoRadius = radius; }
+
+    //  quality tier: sets the sample counts of all techniques, the blur
+    //  radius and the pcf size. the variants of all tiers are compiled
+    //  in advance, so switching is free; changing a single count may
+    //  compile a new variant.
+    Quality quality() const { return _quality; }
+    void setQuality(Quality quality);
+
+    //  shadow pcf kernel width in texels (odd, 1..7)
+    int pcfSize() const { return _pcfSize; }
+    void setPCFSize(int size);
+
+    //  ao technique. every technique uses the same radius and targets,
+    //  so temporal accumulation, blur and upsampling apply to all of them.
+    AOTechnique aoTechnique() const { return _aoTechnique; }
+    void setAOTechnique(AOTechnique technique);
+    const HemisphereParameters& hemisphereParameters() const { return _hemisphere; }
+    void setHemisphereParameters(const HemisphereParameters& parameters);
+    const HBAOParameters& hbaoParameters() const { return _hbao; }
+    void setHBAOParameters(const HBAOParameters& parameters);
+    const GTAOParameters& gtaoParameters() const { return _gtao; }
+    void setGTAOParameters(const GTAOParameters& parameters);
+
+    //  shadow map resolution (per cascade) and number of cascades (1..4).
+    //  the light frustum of each cascade is fitted to its slice of the
+    //  view frustum, clipped to the scene bounds.
+    int shadowMapSize() const { return _shadowMapSize; }
+    void setShadowMapSize(int size);
+    int shadowCascades() const { return _shadowCascades; }
+    void setShadowCascades(int cascades);
+
+    //  filter of the shadow map lookups; the kernel size is pcfSize()
+    ShadowFilter shadowFilter() const { return _shadowFilter; }
+    void setShadowFilter(ShadowFilter filter);
+
+    //  whether the last frame reused the shadow map of the one before,
+    //  because neither the light nor the shadow casters moved
+    bool shadowPassSkipped() const { return _shadowPassSkipped; }
+
+    //  ambient occlusion and shadows in the lighting. with either
+    //  disabled, the passes computing it are skipped.
+    bool isAOEnabled() const { return _aoEnabled; }
+    void setAOEnabled(bool enabled);
+    bool areShadowsEnabled() const { return _shadowsEnabled; }
+    void setShadowsEnabled(bool enabled);
+
+    //  point and spot lights (0..65536) added to the directional light,
+    //  placed at random over the scene with a fixed seed, and how they
+    //  are culled. without any, their pass is skipped.
+    int localLights() const { return _localLights; }
+    void setLocalLights(int count);
+    LightCulling lightCulling() const { return _lightCulling; }
+    void setLightCulling(LightCulling culling);
+
+    //  tiles of the frame whose pass times were read last that had too
+    //  many lights to cull and evaluated all of them, -1 if not measured
+    //  (needs timing and tiled culling)
+    int lightOverflowTiles() const { return _lightOverflowTiles; }
+
+    //  passes run in the last frame, in execution order, and the GL state
+    //  changes issued or skipped as redundant by the frame graph
+    int scheduledPassCount() const { return _frameGraph.scheduledPassCount(); }
+    const char* scheduledPassName(int index) const { return _frameGraph.scheduledPassName(index); }
+    int stateChanges() const { return _frameGraph.stateChanges(); }
+    int skippedStateChanges() const { return _frameGraph.skippedStateChanges(); }
+
+    //  sample distant kernel taps from a min/max depth pyramid
+    bool hiZ() const { return _hiz; }
+    void setHiZ(bool hiz);
+
+    //  adaptive ssao: the fragment path skips the background (by a
+    //  stencil at full ao resolution with stored positions, else in the
+    //  shader), and the hemisphere takes fewer taps for kernels that are
+    //  small on screen and for pixels that the first quarter of its taps
+    //  finds fully open or fully occluded. meanAOSamples() is the mean
+    //  taps per ao pixel (background included) of the frame whose pass
+    //  times were read last, -1 if not measured (needs timing and the
+    //  hemisphere fragment path).
+    bool isAdaptiveAO() const { return _adaptiveAO; }
+    void setAdaptiveAO(bool adaptive);
+    float meanAOSamples() const { return _meanAOSamples; }
+
+    //  ssao path: fragment passes, or a compute shader that tiles depth
+    //  and normals in shared memory and fuses the blur (radius <= 4).
+    //  the compute path always evaluates the hemisphere kernel, i.e. it
+    //  does not use temporal accumulation, and other techniques always use
+    //  the fragment path.
+    bool computeSSAO() const { return _computeSSAO; }
+    void setComputeSSAO(bool compute);
+
+    //  temporal ssao: hemisphere samples per frame (4..64, a divisor of
+    //  the kernel size; the other techniques rotate their directions per
+    //  frame instead), weight of the current frame, and relative depth
+    //  difference above which the reprojected history is rejected
+    bool isTemporal() const { return _temporal; }
+    void setTemporal(bool temporal);
+    int temporalSamples() const { return _temporalSamples; }
+    void setTemporalSamples(int samples);
+    float temporalBlend() const { return _temporalBlend; }
+    void setTemporalBlend(float blend) { _temporalBlend = blend; }
+    float temporalDepthTolerance() const { return _temporalDepthTolerance; }
+    void setTemporalDepthTolerance(float tolerance) { _temporalDepthTolerance = tolerance; }
+
+    //  ssao blur: the cost is linear in the radius (0..16 texels)
+    int blurRadius() const { return _blurRadius; }
+    void setBlurRadius(int radius);
+    float blurDepthSharpness() const { return _blurDepthSharpness; }
+    void setBlurDepthSharpness(float sharpness) { _blurDepthSharpness = sharpness; }
+    float blurNormalPower() const { return _blurNormalPower; }
+    void setBlurNormalPower(float power) { _blurNormalPower = power; }
+
+    //  video memory of the screen-size dependent targets, and what it
+    //  would be without sharing textures between targets
+    size_t renderTargetBytes() const { return _targetPool.allocatedBytes(); }
+    size_t unaliasedRenderTargetBytes() const { return _targetPool.declaredBytes(); }
+
+    //  per-pass GPU timings.
+    //  times are in milliseconds and belong to the previous frame, since
+    //  the queries of the current frame are still in flight. passes that
+    //  did not run in that frame (culled, cached or not needed in the
+    //  current mode) report -1.
+    void setTimingEnabled(bool enabled);
+    bool isTimingEnabled() const { return _timingEnabled; }
+    bool passTimes(double ms[PassCount]) const;
+};
+
+#endif
@@ -0,0 +1,427 @@
+//  Golden-image regression test: renders fixed configurations offscreen
+//  (frozen model rotation and light direction) and compares every frame
+//  with a stored golden image using SSIM. Each configuration also has a
+//  recorded per-pass timing budget that must not be exceeded.
+//
+//  Run with --update to (re)record golden images and budgets, e.g. after
+//  an intended change of the output. Without goldens the test is skipped
+//  (exit code 77), since images and timings depend on GPU and driver.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <QByteArray>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImage>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+#include "ssaorenderer.hpp"
+
+//  exit code that makes CTest report the test as skipped
+#define EXIT_SKIP 77
+
+//  untimed frames before a temporal case is timed and taken, enough for
+//  its history (blend 0.1) to converge
+#define TEMPORAL_WARMUP_FRAMES 64
+
+//  one fixed rendering configuration
+struct TestCase
+{
+    const char* name;
+    SSAORenderer::Quality quality;
+    SSAORenderer::AOTechnique technique;
+    int aoDivisor;
+    bool reconstructPosition;
+    bool compactGBuffer;
+    bool computeSSAO;
+    bool hiz;
+    SSAORenderer::ShadowFilter shadowFilter;
+    int sceneObjects;
+    float modelAngle;
+    int lightAzimuthAngle;
+    bool temporal;
+    bool adaptiveAO;
+    int localLights;
+    SSAORenderer::LightCulling lightCulling;
+    const char* sameImageAs;    // compared with the golden image of that case
+};
+
+static const TestCase testCases[] = {
+    { "default",     SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "light",       SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1, 120.0f, 90, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "low",         SSAORenderer::Quality_Low,   SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "ultra",       SSAORenderer::Quality_Ultra, SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "reconstruct", SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, true,  false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "compact",     SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, true,  true,  false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "compacthalf", SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 2, false, true,  false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "half",        SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 2, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "hiz",         SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, true,  SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "compute",     SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, true,  false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "hbao",        SSAORenderer::Quality_High,  SSAORenderer::AO_HBAO,       1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "gtao",        SSAORenderer::Quality_High,  SSAORenderer::AO_GTAO,       1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "pcf",         SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_PCF,           1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "poisson",     SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_Poisson,       1,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "temporal",    SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, true,  false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "adaptive",    SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, true,      0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "adaptiverec", SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, true,  false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, true,      0, SSAORenderer::LightCulling_Tiled, NULL },
+    { "lights",      SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,   256, SSAORenderer::LightCulling_Tiled, NULL },
+    { "lightsnaive", SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false,   256, SSAORenderer::LightCulling_None,  "lights" },
+    { "lightsmany",  SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false, 16384, SSAORenderer::LightCulling_Tiled, NULL },
+    { "manynaive",   SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF,  1,  30.0f,  0, false, false, 16384, SSAORenderer::LightCulling_None,  "lightsmany" },
+    { "objects",     SSAORenderer::Quality_High,  SSAORenderer::AO_Hemisphere, 1, false, false, false, false, SSAORenderer::Shadow_OptimizedPCF, 64,  30.0f,  0, false, false,     0, SSAORenderer::LightCulling_Tiled, NULL },
+};
+
+//  set an environment variable only if the user did not set it already
+static void setDefaultEnv(const char* name, const char* value)
+{
+    if (!qEnvironmentVariableIsSet(name))
+        qputenv(name, value);
+}
+
+//  -1 without samples, like a pass that did not run
+static double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples.empty() ? -1.0 : samples[samples.size() / 2];
+}
+
+//  luma in [0, 255], row by row
+static std::vector<float> luma(const QImage& image)
+{
+    std::vector<float> result(size_t(image.width()) * image.height());
+    for (int y = 0; y < image.height(); y++)
+    {
+        const uchar* line = image.constScanLine(y);
+        for (int x = 0; x < image.width(); x++)
+        {
+            //  Format_RGB32 is 0xffRRGGBB
+            const QRgb* pixel = reinterpret_cast<const QRgb*>(line) + x;
+            result[size_t(y) * image.width() + x] =
+                0.299f * qRed(*pixel) + 0.587f * qGreen(*pixel) + 0.114f * qBlue(*pixel);
+        }
+    }
+    return result;
+}
+
+//  mean structural similarity of the luma of two images of the same size,
+//  over 8x8 windows with a stride of 4 pixels. also produces a per-pixel
+//  difference image for inspection.
+static double ssim(const QImage& a, const QImage& b, QImage& difference)
+{
+    const int window = 8, stride = 4;
+    const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+    const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+    int width = a.width(), height = a.height();
+    std::vector<float> la = luma(a), lb = luma(b);
+
+    difference = QImage(width, height, QImage::Format_Grayscale8);
+    for (int y = 0; y < height; y++)
+    {
+        uchar* line = difference.scanLine(y);
+        for (int x = 0; x < width; x++)
+        {
+            size_t i = size_t(y) * width + x;
+            line[x] = uchar(std::min(std::fabs(la[i] - lb[i]) * 4.0f, 255.0f));
+        }
+    }
+
+    double sum = 0.0;
+    int windows = 0;
+    for (int y0 = 0; y0 + window <= height; y0 += stride)
+    {
+        for (int x0 = 0; x0 + window <= width; x0 += stride)
+        {
+            double ma = 0.0, mb = 0.0, va = 0.0, vb = 0.0, cov = 0.0;
+            for (int y = y0; y < y0 + window; y++)
+            {
+                for (int x = x0; x < x0 + window; x++)
+                {
+                    size_t i = size_t(y) * width + x;
+                    ma += la[i];
+                    mb += lb[i];
+                }
+            }
+            const double n = window * window;
+            ma /= n;
+            mb /= n;
+            for (int y = y0; y < y0 + window; y++)
+            {
+                for (int x = x0; x < x0 + window; x++)
+                {
+                    size_t i = size_t(y) * width + x;
+                    va += (la[i] - ma) * (la[i] - ma);
+                    vb += (lb[i] - mb) * (lb[i] - mb);
+                    cov += (la[i] - ma) * (lb[i] - mb);
+                }
+            }
+            va /= n - 1.0;
+            vb /= n - 1.0;
+            cov /= n - 1.0;
+            sum += ((2.0 * ma * mb + c1) * (2.0 * cov + c2))
+                / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+            windows++;
+        }
+    }
+    return windows > 0 ? sum / windows : 1.0;
+}
+
+//  render a test case; returns the final image, the median pass times
+//  (-1 for passes that did not run) and the most tiles per frame with too
+//  many lights to cull (-1 if not measured)
+static QImage renderTestCase(const TestCase& testCase, int width, int height, int frames,
+    QOpenGLFramebufferObject& target, double passMs[SSAORenderer::PassCount], int& overflowTiles)
+{
+    SSAORenderer renderer;
+    renderer.setQuality(testCase.quality);
+    renderer.setAOTechnique(testCase.technique);
+    renderer.setAODivisor(testCase.aoDivisor);
+    renderer.setReconstructPosition(testCase.reconstructPosition);
+    renderer.setCompactGBuffer(testCase.compactGBuffer);
+    renderer.setComputeSSAO(testCase.computeSSAO);
+    renderer.setHiZ(testCase.hiz);
+    renderer.setTemporal(testCase.temporal);
+    renderer.setAdaptiveAO(testCase.adaptiveAO);
+    renderer.setShadowFilter(testCase.shadowFilter);
+    renderer.setSceneObjects(testCase.sceneObjects);
+    renderer.setLocalLights(testCase.localLights);
+    renderer.setLightCulling(testCase.lightCulling);
+    renderer.setAnimated(false);
+    renderer.setModelAngle(testCase.modelAngle);
+    renderer.setLightAzimuthAngle(testCase.lightAzimuthAngle);
+    renderer.initialize(width, height);
+    renderer.setTimingEnabled(true);
+
+    QMatrix4x4 P, V;
+    SSAORenderer::defaultCamera(width, height, P, V);
+
+    //  nothing moves, so every frame is the same (once a temporal history
+    //  has converged); the first one is not timed because it may include
+    //  lazy shader compilation
+    const int warmup = testCase.temporal ? TEMPORAL_WARMUP_FRAMES : 2;
+    std::vector<double> samples[SSAORenderer::PassCount];
+    overflowTiles = -1;
+    for (int frame = 0; frame < frames + warmup; frame++)
+    {
+        renderer.render(P, V, width, height, 0.0f, target.handle());
+        double ms[SSAORenderer::PassCount];
+        if (frame < warmup || !renderer.passTimes(ms))
+            continue;
+        for (int i = 0; i < SSAORenderer::PassCount; i++)
+            if (ms[i] >= 0.0)
+                samples[i].push_back(ms[i]);
+        overflowTiles = std::max(overflowTiles, renderer.lightOverflowTiles());
+    }
+    for (int i = 0; i < SSAORenderer::PassCount; i++)
+        passMs[i] = median(samples[i]);
+
+    return target.toImage().convertToFormat(QImage::Format_RGB32);
+}
+
+static bool writeJson(const QString& fileName, const QJsonObject& object)
+{
+    QFile file(fileName);
+    QByteArray json = QJsonDocument(object).toJson(QJsonDocument::Indented);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(json) == json.size();
+}
+
+int main(int argc, char* argv[])
+{
+    //  headless EGL context through Mesa's surfaceless platform
+    setDefaultEnv("QT_QPA_PLATFORM", "eglfs");
+    setDefaultEnv("QT_QPA_EGLFS_INTEGRATION", "none");
+    setDefaultEnv("EGL_PLATFORM", "surfaceless");
+
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Golden-image regression test with per-pass timing budgets.");
+    parser.addHelpOption();
+    QCommandLineOption goldenOption("golden", "Directory of golden images and budgets.", "directory", "golden");
+    QCommandLineOption outputOption("output", "Directory for actual and difference images of failures.", "directory", ".");
+    QCommandLineOption updateOption("update", "Record golden images and budgets instead of comparing.");
+    QCommandLineOption ssimOption("min-ssim", "Minimum SSIM against the golden image.", "value", "0.98");
+    QCommandLineOption marginOption("budget-margin", "Budget = measured time * margin when recording.", "factor", "1.5");
+    QCommandLineOption floorOption("budget-floor", "Budgets are at least the measured time plus this.", "ms", "0.1");
+    QCommandLineOption noBudgetOption("no-budgets", "Only compare images, ignore timing budgets.");
+    QCommandLineOption framesOption("frames", "Timed frames per configuration.", "n", "20");
+    QCommandLineOption widthOption("width", "Framebuffer width.", "pixels", "640");
+    QCommandLineOption heightOption("height", "Framebuffer height.", "pixels", "360");
+    QCommandLineOption caseOption("case", "Only run the named configuration (repeatable).", "name");
+    parser.addOption(goldenOption);
+    parser.addOption(outputOption);
+    parser.addOption(updateOption);
+    parser.addOption(ssimOption);
+    parser.addOption(marginOption);
+    parser.addOption(floorOption);
+    parser.addOption(noBudgetOption);
+    parser.addOption(framesOption);
+    parser.addOption(widthOption);
+    parser.addOption(heightOption);
+    parser.addOption(caseOption);
+    parser.process(app);
+
+    QDir goldenDir(parser.value(goldenOption));
+    QDir outputDir(parser.value(outputOption));
+    bool update = parser.isSet(updateOption);
+    double minSSIM = parser.value(ssimOption).toDouble();
+    double margin = std::max(parser.value(marginOption).toDouble(), 1.0);
+    double budgetFloor = std::max(parser.value(floorOption).toDouble(), 0.0);
+    bool checkBudgets = !parser.isSet(noBudgetOption);
+    int frames = std::max(parser.value(framesOption).toInt(), 1);
+    int width = std::max(parser.value(widthOption).toInt(), 16);
+    int height = std::max(parser.value(heightOption).toInt(), 16);
+    QStringList cases = parser.values(caseOption);
+
+    if (update && !goldenDir.mkpath("."))
+    {
+        std::fprintf(stderr, "cannot create %s\n", qPrintable(goldenDir.path()));
+        return 1;
+    }
+
+    //  create the context, same version as the interactive application.
+    //  without one there is nothing to test, which is not a failure.
+    QSurfaceFormat format;
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setVersion(4, 5);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create())
+    {
+        std::fprintf(stderr, "skipped: cannot create OpenGL %d.%d context\n",
+            format.majorVersion(), format.minorVersion());
+        return EXIT_SKIP;
+    }
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!context.makeCurrent(&surface))
+    {
+        std::fprintf(stderr, "skipped: cannot make OpenGL context current\n");
+        return EXIT_SKIP;
+    }
+    QString gpu = reinterpret_cast<const char*>(context.functions()->glGetString(GL_RENDERER));
+
+    QOpenGLFramebufferObject target(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    int passed = 0, failed = 0, skipped = 0;
+    for (size_t c = 0; c < sizeof(testCases) / sizeof(testCases[0]); c++)
+    {
+        const TestCase& testCase = testCases[c];
+        if (!cases.isEmpty() && !cases.contains(testCase.name))
+            continue;
+        //  cases that must look like another one share its image, but
+        //  have their own budgets
+        const char* imageName = testCase.sameImageAs ? testCase.sameImageAs : testCase.name;
+        QString goldenImage = goldenDir.filePath(QString(imageName) + ".png");
+        QString goldenBudget = goldenDir.filePath(QString(testCase.name) + ".json");
+
+        double passMs[SSAORenderer::PassCount];
+        int overflowTiles;
+        QImage image = renderTestCase(testCase, width, height, frames, target, passMs, overflowTiles);
+        double totalMs = 0.0;
+        for (int i = 0; i < SSAORenderer::PassCount; i++)
+            totalMs += std::max(passMs[i], 0.0);
+
+        if (update)
+        {
+            //  short passes get an absolute margin against timer jitter;
+            //  passes that did not run get no budget
+            QJsonObject budget, passes;
+            for (int i = 0; i < SSAORenderer::PassCount; i++)
+                if (passMs[i] > 0.0)
+                    passes[SSAORenderer::passName(i)] = std::max(passMs[i] * margin, passMs[i] + budgetFloor);
+            budget["renderer"] = gpu;
+            budget["width"] = width;
+            budget["height"] = height;
+            budget["passes_ms"] = passes;
+            budget["total_ms"] = std::max(totalMs * margin, totalMs + budgetFloor);
+            if ((!testCase.sameImageAs && !image.save(goldenImage)) || !writeJson(goldenBudget, budget))
+            {
+                std::fprintf(stderr, "cannot write golden files of %s\n", testCase.name);
+                return 1;
+            }
+            std::printf("%-12s recorded (%.3f ms)\n", testCase.name, totalMs);
+            passed++;
+            continue;
+        }
+
+        QImage golden;
+        if (!golden.load(goldenImage))
+        {
+            std::printf("%-12s skipped: no golden image %s\n", testCase.name, qPrintable(goldenImage));
+            skipped++;
+            continue;
+        }
+        golden = golden.convertToFormat(QImage::Format_RGB32);
+
+        QStringList failures;
+        double similarity = 0.0;
+        QImage difference;
+        if (golden.size() != image.size())
+            failures << QString("size %1x%2 instead of %3x%4").arg(image.width()).arg(image.height())
+                .arg(golden.width()).arg(golden.height());
+        else if ((similarity = ssim(golden, image, difference)) < minSSIM)
+            failures << QString("SSIM %1 < %2").arg(similarity, 0, 'f', 4).arg(minSSIM);
+
+        //  budgets only mean something on the GPU they were recorded on
+        QFile budgetFile(goldenBudget);
+        if (checkBudgets && budgetFile.open(QIODevice::ReadOnly))
+        {
+            QJsonObject budget = QJsonDocument::fromJson(budgetFile.readAll()).object();
+            if (budget["renderer"].toString() != gpu)
+            {
+                std::printf("%-12s budgets recorded on %s, not checked\n", testCase.name,
+                    qPrintable(budget["renderer"].toString()));
+            }
+            else
+            {
+                QJsonObject passes = budget["passes_ms"].toObject();
+                for (int i = 0; i < SSAORenderer::PassCount; i++)
+                {
+                    //  zero: recorded for a pass that did not run
+                    double limit = passes[SSAORenderer::passName(i)].toDouble(-1.0);
+                    if (limit > 0.0 && passMs[i] > limit)
+                        failures << QString("%1 %2 ms > %3 ms").arg(SSAORenderer::passName(i))
+                            .arg(passMs[i], 0, 'f', 3).arg(limit, 0, 'f', 3);
+                }
+                double limit = budget["total_ms"].toDouble(-1.0);
+                if (limit >= 0.0 && totalMs > limit)
+                    failures << QString("total %1 ms > %2 ms").arg(totalMs, 0, 'f', 3).arg(limit, 0, 'f', 3);
+            }
+        }
+
+        if (failures.isEmpty())
+        {
+            std::printf("%-12s passed (SSIM %.4f, %.3f ms", testCase.name, similarity, totalMs);
+            if (overflowTiles >= 0)
+                std::printf(", %d tiles with too many lights", overflowTiles);
+            std::printf(")\n");
+            passed++;
+        }
+        else
+        {
+            std::printf("%-12s FAILED: %s\n", testCase.name, qPrintable(failures.join(", ")));
+            image.save(outputDir.filePath(QString(testCase.name) + ".actual.png"));
+            if (!difference.isNull())
+                difference.save(outputDir.filePath(QString(testCase.name) + ".diff.png"));
+            failed++;
+        }
+    }
+
+    std::printf("%d passed, %d failed, %d skipped\n", passed, failed, skipped);
+    if (failed > 0)
+        return 1;
+    return passed == 0 ? EXIT_SKIP : 0;
+}
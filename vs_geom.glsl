@@ -1,27 +1,52 @@
-uniform mat4 projection_matrix;
-uniform mat4 modelview_matrix;
-uniform mat3 normal_matrix;
-uniform mat4 mvp_matrix_shadow;
+#include "frame.glsl"
 
 layout(location = 0) in vec4 position;
 layout(location = 1) in vec3 normal;
 
+//  per instance, see Scene
+layout(location = 4) in mat4 model_matrix;
+layout(location = 8) in mat4 prev_model_matrix;
+layout(location = 12) in vec4 instance_color;
+
 smooth out vec3 vposition;  // position in eye space
 smooth out vec3 vnormal;    // normal in eye space, not normalized
+flat out vec3 vcolor;       // albedo of the instance
+#ifndef SHADOW_FROM_POSITION
 smooth out vec4 vshadowpos;  // view vector in eye space, not normalized
+#endif
+
+#ifdef TEMPORAL
+smooth out vec4 vclippos;      // position in clip space
+smooth out vec4 vprevclippos;  // position in clip space of the previous frame
+smooth out float vprevz;       // view-space z of the previous frame
+#endif
 
 void main()
 {
     //  calculate position in view space 
+    mat4 modelview_matrix = view_matrix * model_matrix;
     vec3 pos = (modelview_matrix * position).xyz;
     vposition = pos;
 
-    //  calculate normal in view space
-    vnormal = normal_matrix * normal;
+    //  calculate normal in view space, instances only carry rotation and
+    //  uniform scale so the modelview matrix itself will do, fs_geom
+    //  normalizes
+    vnormal = mat3(modelview_matrix) * normal;
+    vcolor = instance_color.rgb;
 
     //  calculate position in shadow map
-    vshadowpos = mvp_matrix_shadow * position;
+#ifndef SHADOW_FROM_POSITION
+    vshadowpos = shadow_matrix * (model_matrix * position);
+#endif
     
     //  calculate position in projection space
     gl_Position = projection_matrix * vec4(pos, 1.0);
+
+#ifdef TEMPORAL
+    //  where this vertex was in the previous frame
+    vec4 prevpos = prev_view_matrix * (prev_model_matrix * position);
+    vclippos = gl_Position;
+    vprevclippos = prev_projection_matrix * prevpos;
+    vprevz = prevpos.z;
+#endif
 }
\ No newline at end of file